@@ -29,32 +29,6 @@ Bounds::Bounds(const WorldDimension& worldDimension, const FloatPoint& position,
            "Bounds are larger than the world containing it");
 }
 
-uint32_t Bounds::index(uint32_t x, uint32_t y) const {
-    ASSERT(x < _dimension.getWidth() && y < _dimension.getHeight(),
-           "Invalid coordinates");
-    return y * _dimension.getWidth() + x;
-}
-
-uint32_t Bounds::area() const {
-    return _dimension.getArea();
-}
-
-uint32_t Bounds::width() const {
-    return _dimension.getWidth();
-}
-
-uint32_t Bounds::height() const {
-    return _dimension.getHeight();
-}
-
-uint32_t Bounds::leftAsUint() const {
-    return (uint32_t)_position.getX();
-}
-
-uint32_t Bounds::topAsUint() const {
-    return (uint32_t)_position.getY();
-}
-
 uint32_t Bounds::rightAsUintNonInclusive() const {
     return leftAsUint() + width() - 1;
 }
@@ -92,6 +66,13 @@ void Bounds::grow(int dx, int dy) {
            + " world height=" + Platec::to_string(_worldDimension.getHeight()));
 }
 
+void Bounds::shrink(int dx, int dy) {
+    ASSERT(dx >= 0 && dy >= 0, "Negative delta is not allowed");
+    ASSERT((uint32_t)dx < width() && (uint32_t)dy < height(),
+           "Bounds can not shrink to nothing");
+    _dimension.shrink(dx, dy);
+}
+
 Platec::Rectangle Bounds::asRect() const {
     const uint32_t ilft = leftAsUint();
     const uint32_t itop = topAsUint();
@@ -101,12 +82,3 @@ Platec::Rectangle Bounds::asRect() const {
     return Platec::Rectangle(_worldDimension, ilft, irgt, itop, ibtm);
 }
 
-uint32_t Bounds::getMapIndex(uint32_t* px, uint32_t* py) const {
-    return asRect().getMapIndex(px, py);
-}
-
-uint32_t Bounds::getValidMapIndex(uint32_t* px, uint32_t* py) const {
-    uint32_t res = asRect().getMapIndex(px, py);
-    ASSERT(res != BAD_INDEX, "BAD map index found");
-    return res;
-}
@@ -75,6 +75,11 @@ public:
     /// @param dy must be positive or zero
     virtual void grow(int dx, int dy) = 0;
 
+    /// Shrink the plate from the right and the bottom.
+    /// @param dx must be positive or zero, and less than the width
+    /// @param dy must be positive or zero, and less than the height
+    virtual void shrink(int dx, int dy) = 0;
+
     /// Translate world coordinates into offset within plate's height map.
     ///
     /// If the global world map coordinates are within plate's height map,
@@ -100,7 +105,7 @@ public:
 };
 
 /// Plate bounds.
-class Bounds : public IBounds
+class Bounds PLATEC_FINAL : public IBounds
 {
 public:
 
@@ -111,20 +116,61 @@ public:
            const FloatPoint& position,
            const Dimension& dimension);
 
-    uint32_t index(uint32_t x, uint32_t y) const;
-    uint32_t area() const;
-    uint32_t width() const;
-    uint32_t height() const;
-    uint32_t leftAsUint() const;
-    uint32_t topAsUint() const;
+    uint32_t index(uint32_t x, uint32_t y) const {
+        ASSERT(x < _dimension.getWidth() && y < _dimension.getHeight(),
+               "Invalid coordinates");
+        return y * _dimension.getWidth() + x;
+    }
+    uint32_t area() const {
+        return _dimension.getArea();
+    }
+    uint32_t width() const {
+        return _dimension.getWidth();
+    }
+    uint32_t height() const {
+        return _dimension.getHeight();
+    }
+    uint32_t leftAsUint() const {
+        return (uint32_t)_position.getX();
+    }
+    uint32_t topAsUint() const {
+        return (uint32_t)_position.getY();
+    }
     uint32_t rightAsUintNonInclusive() const;
     uint32_t bottomAsUintNonInclusive() const;
     bool containsWorldPoint(uint32_t x, uint32_t y) const;
     bool isInLimits(float x, float y) const;
     void shift(float dx, float dy);
     void grow(int dx, int dy);
-    uint32_t getValidMapIndex(uint32_t* px, uint32_t* py) const;
-    uint32_t getMapIndex(uint32_t* x, uint32_t* y) const;
+    void shrink(int dx, int dy);
+    uint32_t getValidMapIndex(uint32_t* px, uint32_t* py) const {
+        const uint32_t res = getMapIndex(px, py);
+        ASSERT(res != BAD_INDEX, "BAD map index found");
+        return res;
+    }
+
+    // Same as asRect().getMapIndex(), without building the rectangle.
+    uint32_t getMapIndex(uint32_t* px, uint32_t* py) const {
+        const uint32_t world_width = _worldDimension.getWidth();
+        const uint32_t world_height = _worldDimension.getHeight();
+        const uint32_t ilft = leftAsUint();
+        const uint32_t itop = topAsUint();
+
+        // Offset from the top left corner, wrapped around world's edges.
+        uint32_t x = *px % world_width;
+        uint32_t y = *py % world_height;
+        x += (x < ilft) ? world_width : 0;
+        y += (y < itop) ? world_height : 0;
+        x -= ilft;
+        y -= itop;
+
+        if (x < width() && y < height()) {
+            *px = x;
+            *py = y;
+            return y * width() + x;
+        }
+        return BAD_INDEX;
+    }
 
 private:
 
@@ -0,0 +1,428 @@
+/******************************************************************************
+ *  plate-tectonics, a plate tectonics simulation library
+ *  Copyright (C) 2012-2013 Lauri Viitanen
+ *  Copyright (C) 2014-2015 Federico Tomassetti, Bret Curtis
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, see http://www.gnu.org/licenses/
+ *****************************************************************************/
+
+#include "erosion_stencil.hpp"
+#include <algorithm>
+#include "tile_occupancy.hpp"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+void ErosionStencil::resize(uint32_t width)
+{
+    if (_zeros.size() >= width)
+        return;
+
+    for (uint32_t r = 0; r < 3; ++r)
+        for (uint32_t i = 0; i < SHARES; ++i) {
+            _rows[r].a[i].resize(width);
+            _rows[r].b[i].resize(width);
+        }
+    _zeros.assign(width, 0.0f);
+}
+
+void ErosionStencil::clear(Row& row, uint32_t x0, uint32_t x1)
+{
+    for (uint32_t i = 0; i < SHARES; ++i)
+        for (uint32_t x = x0; x < x1; ++x)
+            row.a[i][x] = row.b[i][x] = 0.0f;
+}
+
+void ErosionStencil::share(uint32_t x, float* a, float* b) const
+{
+    for (uint32_t i = 0; i < SHARES; ++i) {
+        a[i] = _rows[0].a[i][x];
+        b[i] = _rows[0].b[i][x];
+    }
+}
+
+// The arithmetic follows the original loop of plate::erode operation by
+// operation, booleans turning into factors of 0 and 1 included.
+void ErosionStencil::flowPoint(Row& out, const float* map, uint32_t width, uint32_t height,
+                               uint32_t x, uint32_t y, bool wrap_x,
+                               bool wrap_y, float lower_bound)
+{
+    const float* row = map + y * width;
+    const float h = row[x];
+
+    // Neighbours lower than this point, zero if there's none.
+    float w_crust = 0, e_crust = 0, n_crust = 0, s_crust = 0;
+    if (x > 0 || wrap_x) {
+        const float c = row[x > 0 ? x - 1 : width - 1];
+        w_crust = c < h ? c : 0;
+    }
+    if (x + 1 < width || wrap_x) {
+        const float c = row[x + 1 < width ? x + 1 : 0];
+        e_crust = c < h ? c : 0;
+    }
+    if (y > 0 || wrap_y) {
+        const float c = map[(y > 0 ? y - 1 : height - 1) * width + x];
+        n_crust = c < h ? c : 0;
+    }
+    if (y + 1 < height || wrap_y) {
+        const float c = map[(y + 1 < height ? y + 1 : 0) * width + x];
+        s_crust = c < h ? c : 0;
+    }
+
+    for (uint32_t i = 0; i < SHARES; ++i)
+        out.a[i][x] = out.b[i][x] = 0.0f;
+
+    // This location is low or has no lower neighbours. In either case it
+    // gives nothing away.
+    if (h < lower_bound || w_crust + e_crust + n_crust + s_crust == 0)
+        return;
+
+    const float w_diff = h - w_crust;
+    const float e_diff = h - e_crust;
+    const float n_diff = h - n_crust;
+    const float s_diff = h - s_crust;
+
+    float min_diff = w_diff;
+    min_diff -= (min_diff - e_diff) * (e_diff < min_diff);
+    min_diff -= (min_diff - n_diff) * (n_diff < min_diff);
+    min_diff -= (min_diff - s_diff) * (s_diff < min_diff);
+
+    const float diff_sum = (w_diff - min_diff) * (w_crust > 0) +
+                           (e_diff - min_diff) * (e_crust > 0) +
+                           (n_diff - min_diff) * (n_crust > 0) +
+                           (s_diff - min_diff) * (s_crust > 0);
+
+    out.a[SELF][x] = -min_diff;
+    if (diff_sum < min_diff)
+    {
+        // Level the lower neighbours with this point, then spread the rest
+        // equally among all of them.
+        out.a[WEST][x] = (w_diff - min_diff) * (w_crust > 0);
+        out.a[EAST][x] = (e_diff - min_diff) * (e_crust > 0);
+        out.a[NORTH][x] = (n_diff - min_diff) * (n_crust > 0);
+        out.a[SOUTH][x] = (s_diff - min_diff) * (s_crust > 0);
+
+        const float rest = (min_diff - diff_sum) /
+                           (1 + (w_crust > 0) + (e_crust > 0) +
+                            (n_crust > 0) + (s_crust > 0));
+        out.b[WEST][x] = rest * (w_crust > 0);
+        out.b[EAST][x] = rest * (e_crust > 0);
+        out.b[NORTH][x] = rest * (n_crust > 0);
+        out.b[SOUTH][x] = rest * (s_crust > 0);
+        out.b[SELF][x] = rest;
+    }
+    else
+    {
+        // Level this point with its tallest lower neighbour, spreading the
+        // crust among the others.
+        const float unit = min_diff / diff_sum;
+        out.a[WEST][x] = unit * (w_diff - min_diff) * (w_crust > 0);
+        out.a[EAST][x] = unit * (e_diff - min_diff) * (e_crust > 0);
+        out.a[NORTH][x] = unit * (n_diff - min_diff) * (n_crust > 0);
+        out.a[SOUTH][x] = unit * (s_diff - min_diff) * (s_crust > 0);
+    }
+}
+
+#ifdef __SSE2__
+
+static inline __m128 select(__m128 mask, __m128 a, __m128 b)
+{
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+// Same as flowPoint for the points [x0, x1[ of a row, none of which is at
+// the row's ends. Both branches are computed and the lanes pick theirs.
+void ErosionStencil::flowSimd(Row& out, const float* row,
+                              const float* above, const float* below,
+                              bool has_above, bool has_below, uint32_t x0,
+                              uint32_t x1, float lower_bound)
+{
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 all = _mm_castsi128_ps(_mm_set1_epi32(-1));
+    const __m128 sign = _mm_castsi128_ps(_mm_set1_epi32(0x80000000));
+    const __m128 bound = _mm_set1_ps(lower_bound);
+    const __m128 n_valid = has_above ? all : zero;
+    const __m128 s_valid = has_below ? all : zero;
+
+    uint32_t x = x0;
+    for (; x + 4 <= x1; x += 4)
+    {
+        const __m128 h = _mm_loadu_ps(row + x);
+        const __m128 hw = _mm_loadu_ps(row + x - 1);
+        const __m128 he = _mm_loadu_ps(row + x + 1);
+        const __m128 hn = _mm_loadu_ps(above + x);
+        const __m128 hs = _mm_loadu_ps(below + x);
+
+        const __m128 w_crust = _mm_and_ps(_mm_cmplt_ps(hw, h), hw);
+        const __m128 e_crust = _mm_and_ps(_mm_cmplt_ps(he, h), he);
+        const __m128 n_crust = _mm_and_ps(_mm_and_ps(_mm_cmplt_ps(hn, h), n_valid), hn);
+        const __m128 s_crust = _mm_and_ps(_mm_and_ps(_mm_cmplt_ps(hs, h), s_valid), hs);
+
+        const __m128 sum = _mm_add_ps(_mm_add_ps(_mm_add_ps(w_crust, e_crust),
+                                                 n_crust), s_crust);
+        const __m128 flows = _mm_andnot_ps(_mm_or_ps(_mm_cmplt_ps(h, bound),
+                                                     _mm_cmpeq_ps(sum, zero)), all);
+
+        const __m128 w_diff = _mm_sub_ps(h, w_crust);
+        const __m128 e_diff = _mm_sub_ps(h, e_crust);
+        const __m128 n_diff = _mm_sub_ps(h, n_crust);
+        const __m128 s_diff = _mm_sub_ps(h, s_crust);
+
+        __m128 min_diff = w_diff;
+        min_diff = _mm_sub_ps(min_diff, _mm_mul_ps(_mm_sub_ps(min_diff, e_diff),
+                              _mm_and_ps(_mm_cmplt_ps(e_diff, min_diff), one)));
+        min_diff = _mm_sub_ps(min_diff, _mm_mul_ps(_mm_sub_ps(min_diff, n_diff),
+                              _mm_and_ps(_mm_cmplt_ps(n_diff, min_diff), one)));
+        min_diff = _mm_sub_ps(min_diff, _mm_mul_ps(_mm_sub_ps(min_diff, s_diff),
+                              _mm_and_ps(_mm_cmplt_ps(s_diff, min_diff), one)));
+
+        const __m128 w_lower = _mm_and_ps(_mm_cmpgt_ps(w_crust, zero), one);
+        const __m128 e_lower = _mm_and_ps(_mm_cmpgt_ps(e_crust, zero), one);
+        const __m128 n_lower = _mm_and_ps(_mm_cmpgt_ps(n_crust, zero), one);
+        const __m128 s_lower = _mm_and_ps(_mm_cmpgt_ps(s_crust, zero), one);
+
+        const __m128 w_level = _mm_mul_ps(_mm_sub_ps(w_diff, min_diff), w_lower);
+        const __m128 e_level = _mm_mul_ps(_mm_sub_ps(e_diff, min_diff), e_lower);
+        const __m128 n_level = _mm_mul_ps(_mm_sub_ps(n_diff, min_diff), n_lower);
+        const __m128 s_level = _mm_mul_ps(_mm_sub_ps(s_diff, min_diff), s_lower);
+        const __m128 diff_sum = _mm_add_ps(_mm_add_ps(_mm_add_ps(w_level, e_level),
+                                                      n_level), s_level);
+
+        // Lanes that level their lower neighbours first.
+        const __m128 level = _mm_cmplt_ps(diff_sum, min_diff);
+        const __m128 count = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_add_ps(one, w_lower),
+                                                              e_lower), n_lower), s_lower);
+        const __m128 rest = _mm_div_ps(_mm_sub_ps(min_diff, diff_sum), count);
+        const __m128 unit = _mm_div_ps(min_diff, diff_sum);
+
+        const __m128 first = flows;
+        const __m128 second = _mm_and_ps(flows, level);
+        _mm_storeu_ps(&out.a[WEST][x], _mm_and_ps(first, select(level, w_level,
+                      _mm_mul_ps(_mm_mul_ps(unit, _mm_sub_ps(w_diff, min_diff)), w_lower))));
+        _mm_storeu_ps(&out.a[EAST][x], _mm_and_ps(first, select(level, e_level,
+                      _mm_mul_ps(_mm_mul_ps(unit, _mm_sub_ps(e_diff, min_diff)), e_lower))));
+        _mm_storeu_ps(&out.a[NORTH][x], _mm_and_ps(first, select(level, n_level,
+                      _mm_mul_ps(_mm_mul_ps(unit, _mm_sub_ps(n_diff, min_diff)), n_lower))));
+        _mm_storeu_ps(&out.a[SOUTH][x], _mm_and_ps(first, select(level, s_level,
+                      _mm_mul_ps(_mm_mul_ps(unit, _mm_sub_ps(s_diff, min_diff)), s_lower))));
+        _mm_storeu_ps(&out.a[SELF][x], _mm_and_ps(first, _mm_xor_ps(min_diff, sign)));
+
+        _mm_storeu_ps(&out.b[WEST][x], _mm_and_ps(second, _mm_mul_ps(rest, w_lower)));
+        _mm_storeu_ps(&out.b[EAST][x], _mm_and_ps(second, _mm_mul_ps(rest, e_lower)));
+        _mm_storeu_ps(&out.b[NORTH][x], _mm_and_ps(second, _mm_mul_ps(rest, n_lower)));
+        _mm_storeu_ps(&out.b[SOUTH][x], _mm_and_ps(second, _mm_mul_ps(rest, s_lower)));
+        _mm_storeu_ps(&out.b[SELF][x], _mm_and_ps(second, rest));
+    }
+}
+
+#endif
+
+
+void ErosionStencil::flowRun(Row& row, const float* map, uint32_t width,
+                             uint32_t height, uint32_t y, uint32_t x0,
+                             uint32_t x1, bool wrap_x, bool wrap_y,
+                             float lower_bound, bool simd)
+{
+    // The ends of the row have their neighbours elsewhere.
+    uint32_t first = x0, last = x1;
+    if (first == 0 && first < last)
+        flowPoint(row, map, width, height, first++, y, wrap_x, wrap_y, lower_bound);
+    if (last == width && first < last)
+        flowPoint(row, map, width, height, --last, y, wrap_x, wrap_y, lower_bound);
+
+#ifdef __SSE2__
+    if (simd)
+    {
+        const bool has_above = y > 0 || wrap_y;
+        const bool has_below = y + 1 < height || wrap_y;
+        const float* above = has_above ? map + (y > 0 ? y - 1 : height - 1) * width
+                                       : &_zeros[0];
+        const float* below = has_below ? map + (y + 1 < height ? y + 1 : 0) * width
+                                       : &_zeros[0];
+
+        const uint32_t vectors = (last - first) / 4 * 4;
+        flowSimd(row, map + y * width, above, below, has_above, has_below,
+                 first, first + vectors, lower_bound);
+        first += vectors;
+    }
+#endif
+
+    for (uint32_t x = first; x < last; ++x)
+        flowPoint(row, map, width, height, x, y, wrap_x, wrap_y, lower_bound);
+}
+
+void ErosionStencil::flow(const float* map, uint32_t width, uint32_t height,
+                          uint32_t y, uint32_t x0, uint32_t x1, bool wrap_x,
+                          bool wrap_y, float lower_bound, bool simd)
+{
+    resize(width);
+    flowRun(_rows[0], map, width, height, y, x0, x1, wrap_x, wrap_y,
+            lower_bound, simd);
+}
+
+void ErosionStencil::computeRow(Row& row, const float* map, uint32_t width,
+                                uint32_t height, uint32_t y, bool wrap_x,
+                                bool wrap_y, float lower_bound,
+                                const TileOccupancy& tiles)
+{
+    row.y = y;
+    row.runs.clear();
+
+    // Points of empty tiles are zero and give nothing away. Rows that wrap
+    // around are taken whole.
+    for (uint32_t x0, x1 = 0; tiles.nextRun(y, x1, width, x0, x1);)
+    {
+        if (wrap_x) {
+            x0 = 0;
+            x1 = width;
+        }
+        row.runs.push_back(x0);
+        row.runs.push_back(x1);
+
+        // The points next to the run have no crust, they only receive.
+        clear(row, x0 > 2 ? x0 - 2 : 0, x0);
+        clear(row, x1, x1 + 2 < width ? x1 + 2 : width);
+        flowRun(row, map, width, height, y, x0, x1, wrap_x, wrap_y,
+                lower_bound, true);
+    }
+}
+
+// Add the shares a row above or below gives to "line".
+void ErosionStencil::receive(float* line, const Row& row, uint32_t direction)
+{
+    const float* a = &row.a[direction][0];
+    const float* b = &row.b[direction][0];
+    for (uint32_t i = 0; i < row.runs.size(); i += 2)
+        for (uint32_t x = row.runs[i]; x < row.runs[i + 1]; ++x) {
+            line[x] += a[x];
+            line[x] += b[x];
+        }
+}
+
+// Add the crust of a row and the shares its points give each other to
+// "line". Each point takes from its west neighbour, then its own crust and
+// shares, then from its east neighbour: the order the original loop
+// visited them in.
+void ErosionStencil::spread(float* line, const float* crust, const Row& row,
+                            uint32_t width, bool wrap_x)
+{
+    const float* wa = &row.a[WEST][0];
+    const float* wb = &row.b[WEST][0];
+    const float* ea = &row.a[EAST][0];
+    const float* eb = &row.b[EAST][0];
+    const float* sa = &row.a[SELF][0];
+    const float* sb = &row.b[SELF][0];
+
+    for (uint32_t i = 0; i < row.runs.size(); i += 2)
+    {
+        // Points next to the run receive too.
+        uint32_t first = row.runs[i] > 0 ? row.runs[i] - 1 : 0;
+        uint32_t last = row.runs[i + 1] < width ? row.runs[i + 1] + 1 : width;
+
+        if (first == 0 && first < last)
+        {
+            // Its west neighbour, if any, is the last point of the row.
+            float t = line[0] + crust[0];
+            t += sa[0];
+            t += sb[0];
+            if (width > 1) {
+                t += wa[1];
+                t += wb[1];
+            }
+            if (wrap_x) {
+                t += ea[width - 1];
+                t += eb[width - 1];
+            }
+            line[first++] = t;
+        }
+        if (last == width && first < last)
+        {
+            // Its east neighbour, if any, is the first point of the row.
+            const uint32_t x = --last;
+            float t = line[x];
+            if (wrap_x) {
+                t += wa[0];
+                t += wb[0];
+            }
+            t += ea[x - 1];
+            t += eb[x - 1];
+            t += crust[x];
+            t += sa[x];
+            t += sb[x];
+            line[x] = t;
+        }
+
+        for (uint32_t x = first; x < last; ++x)
+        {
+            float t = line[x] + ea[x - 1];
+            t += eb[x - 1];
+            t += crust[x];
+            t += sa[x];
+            t += sb[x];
+            t += wa[x + 1];
+            t += wb[x + 1];
+            line[x] = t;
+        }
+    }
+}
+
+void ErosionStencil::erode(const float* map, float* out, uint32_t width,
+                           uint32_t height, bool wrap_x, bool wrap_y,
+                           float lower_bound, const TileOccupancy& tiles,
+                           uint32_t y0, uint32_t y1)
+{
+    if (y0 >= y1)
+        return;
+    resize(width);
+
+    Row* above = &_rows[0];
+    Row* row = &_rows[1];
+    Row* below = &_rows[2];
+    computeRow(*row, map, width, height, y0, wrap_x, wrap_y, lower_bound, tiles);
+    if (y0 > 0 || wrap_y)
+        computeRow(*above, map, width, height, y0 > 0 ? y0 - 1 : height - 1,
+                   wrap_x, wrap_y, lower_bound, tiles);
+
+    for (uint32_t y = y0; y < y1; ++y)
+    {
+        const bool has_above = y > 0 || wrap_y;
+        const bool has_below = y + 1 < height || wrap_y;
+        if (has_below)
+            computeRow(*below, map, width, height, y + 1 < height ? y + 1 : 0,
+                       wrap_x, wrap_y, lower_bound, tiles);
+
+        // The original loop went through the rows top to bottom: the shares
+        // of the rows before this one came first, those after it last.
+        float* line = out + y * width;
+        fill(line, line + width, 0.0f);
+        if (has_below && below->y < y)
+            receive(line, *below, NORTH);
+        if (has_above && above->y < y)
+            receive(line, *above, SOUTH);
+        spread(line, map + y * width, *row, width, wrap_x);
+        if (has_below && below->y > y)
+            receive(line, *below, NORTH);
+        if (has_above && above->y > y)
+            receive(line, *above, SOUTH);
+
+        Row* done = above;
+        above = row;
+        row = below;
+        below = done;
+    }
+}
@@ -0,0 +1,116 @@
+/******************************************************************************
+ *  plate-tectonics, a plate tectonics simulation library
+ *  Copyright (C) 2012-2013 Lauri Viitanen
+ *  Copyright (C) 2014-2015 Federico Tomassetti, Bret Curtis
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, see http://www.gnu.org/licenses/
+ *****************************************************************************/
+
+#ifndef EROSION_STENCIL_HPP
+#define EROSION_STENCIL_HPP
+
+#include <vector>
+#include "utils.hpp"
+
+class TileOccupancy;
+
+/// Spreads the crust of a plate's points among their lower neighbours, the
+/// second half of plate::erode.
+///
+/// Each point taller than some of its four neighbours gives crust to them.
+/// The shares depend on the point and its neighbours only, so they are
+/// first computed for a whole row, four points at a time with SSE2 where
+/// available. Each row of the eroded map then gathers the shares of its own
+/// row and of the rows above and below, adding them in the very order the
+/// original point by point loop did. This keeps the floating point sums
+/// bit-identical to it: the vectorized path has no tolerance. As every row
+/// is written by its own gather, bands of rows can be eroded on different
+/// threads, each band with its own stencil.
+class ErosionStencil
+{
+public:
+    /// Spread the crust of "map" into rows [y0, y1[ of "out".
+    ///
+    /// @param  map         Plate's crust.
+    /// @param  out         Eroded crust. Only rows [y0, y1[ are written.
+    /// @param  width       Width of the maps in points.
+    /// @param  height      Height of the maps in points.
+    /// @param  wrap_x      Plate is as wide as the world, rows wrap around.
+    /// @param  wrap_y      Plate is as tall as the world, columns wrap.
+    /// @param  lower_bound Points lower than this give no crust away.
+    /// @param  tiles       Parts of the map that may hold crust.
+    /// @param  y0          First row to write.
+    /// @param  y1          End of the rows to write.
+    void erode(const float* map, float* out, uint32_t width, uint32_t height,
+               bool wrap_x, bool wrap_y, float lower_bound,
+               const TileOccupancy& tiles, uint32_t y0, uint32_t y1);
+
+    /// Same as above for all rows.
+    void erode(const float* map, float* out, uint32_t width, uint32_t height,
+               bool wrap_x, bool wrap_y, float lower_bound,
+               const TileOccupancy& tiles)
+    {
+        erode(map, out, width, height, wrap_x, wrap_y, lower_bound, tiles,
+              0, height);
+    }
+
+    /// Compute the shares of points [x0, x1[ of row "y". Meant for tests;
+    /// "simd" selects the vectorized kernel, if the build has one.
+    void flow(const float* map, uint32_t width, uint32_t height, uint32_t y,
+              uint32_t x0, uint32_t x1, bool wrap_x, bool wrap_y,
+              float lower_bound, bool simd);
+
+    /// Shares computed by flow for point x: crust given to the west, east,
+    /// north and south neighbours and to the point itself, in this order.
+    /// Each share is added in two steps, "a" and then "b".
+    void share(uint32_t x, float* a, float* b) const;
+
+private:
+    enum { WEST, EAST, NORTH, SOUTH, SELF, SHARES };
+
+    /// Shares of the points of one row.
+    struct Row
+    {
+        std::vector<float> a[SHARES]; ///< First step of the shares.
+        std::vector<float> b[SHARES]; ///< Second step of the shares.
+        std::vector<uint32_t> runs;   ///< Pairs of begin and end of the
+                                      ///< points that may give crust.
+        uint32_t y;                   ///< Row of the map.
+    };
+
+    void resize(uint32_t width);
+    void computeRow(Row& row, const float* map, uint32_t width,
+                    uint32_t height, uint32_t y, bool wrap_x, bool wrap_y,
+                    float lower_bound, const TileOccupancy& tiles);
+    void flowRun(Row& row, const float* map, uint32_t width, uint32_t height,
+                 uint32_t y, uint32_t x0, uint32_t x1, bool wrap_x,
+                 bool wrap_y, float lower_bound, bool simd);
+    static void flowPoint(Row& row, const float* map, uint32_t width,
+                          uint32_t height, uint32_t x, uint32_t y, bool wrap_x,
+                          bool wrap_y, float lower_bound);
+#ifdef __SSE2__
+    static void flowSimd(Row& row, const float* line, const float* above,
+                         const float* below, bool has_above, bool has_below,
+                         uint32_t x0, uint32_t x1, float lower_bound);
+#endif
+    static void clear(Row& row, uint32_t x0, uint32_t x1);
+    static void receive(float* line, const Row& row, uint32_t direction);
+    static void spread(float* line, const float* crust, const Row& row,
+                       uint32_t width, bool wrap_x);
+
+    Row _rows[3];              ///< Rows above, at and below the one written.
+    std::vector<float> _zeros; ///< Stands for the rows off the plate.
+};
+
+#endif
@@ -0,0 +1,192 @@
+/******************************************************************************
+ *  plate-tectonics, a plate tectonics simulation library
+ *  Copyright (C) 2012-2013 Lauri Viitanen
+ *  Copyright (C) 2014-2015 Federico Tomassetti, Bret Curtis
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, see http://www.gnu.org/licenses/
+ *****************************************************************************/
+
+#include "flow_accumulation.hpp"
+#include "tile_occupancy.hpp"
+#include <algorithm>
+
+using namespace std;
+
+const uint32_t FlowAccumulation::NONE;
+const uint32_t FlowAccumulation::FULL_FLOW;
+
+// The eight neighbours: the four sides first, then the corners.
+static const int DX[8] = { -1, 1, 0, 0, -1, 1, -1, 1 };
+static const int DY[8] = { 0, 0, -1, 1, -1, -1, 1, 1 };
+static const float INV_DIST[8] = { 1.0f, 1.0f, 1.0f, 1.0f,
+                                   0.70710678f, 0.70710678f,
+                                   0.70710678f, 0.70710678f };
+
+// Runs of points that may be land: those of the occupied tiles, or whole
+// rows when the bound lets empty points be land too.
+static bool nextLandRun(const TileOccupancy& tiles, float lower_bound,
+                        uint32_t y, uint32_t from, uint32_t width,
+                        uint32_t& x0, uint32_t& x1)
+{
+    if (lower_bound > 0)
+        return tiles.nextRun(y, from, width, x0, x1);
+
+    x0 = 0;
+    x1 = width;
+    return from == 0;
+}
+
+uint32_t FlowAccumulation::neighbour(uint32_t x, uint32_t y, uint32_t d) const
+{
+    int nx = (int)x + DX[d];
+    int ny = (int)y + DY[d];
+
+    if (nx < 0 || nx >= (int)_width) {
+        if (!_wrap_x)
+            return NONE;
+        nx = nx < 0 ? _width - 1 : 0;
+    }
+    if (ny < 0 || ny >= (int)_height) {
+        if (!_wrap_y)
+            return NONE;
+        ny = ny < 0 ? _height - 1 : 0;
+    }
+    return ny * _width + nx;
+}
+
+void FlowAccumulation::push(uint32_t index, float height)
+{
+    Entry entry;
+    entry.height = height;
+    entry.seq = _seq++;
+    entry.index = index;
+
+    _filled[index] = height;
+    _reached[index] = 1;
+    _queue.push_back(entry);
+    push_heap(_queue.begin(), _queue.end());
+}
+
+void FlowAccumulation::compute(const float* map, uint32_t width,
+                               uint32_t height, bool wrap_x, bool wrap_y,
+                               float lower_bound, const TileOccupancy& tiles)
+{
+    const uint32_t area = width * height;
+    _width = width;
+    _height = height;
+    _wrap_x = wrap_x;
+    _wrap_y = wrap_y;
+    _seq = 0;
+    _filled.assign(area, 0.0f);
+    _reached.assign(area, 0);
+    _receivers.assign(area, NONE);
+    _accumulation.assign(area, 0);
+    _order.clear();
+    _queue.clear();
+
+    // The flood starts from the land next to water or to an edge that does
+    // not wrap.
+    uint32_t lowest = NONE;
+    for (uint32_t y = 0; y < height; ++y)
+    {
+        for (uint32_t x0, x1 = 0; nextLandRun(tiles, lower_bound, y, x1, width, x0, x1);)
+        {
+            for (uint32_t x = x0; x < x1; ++x)
+            {
+                const uint32_t i = y * width + x;
+                if (map[i] < lower_bound)
+                    continue;
+                if (lowest == NONE || map[i] < map[lowest])
+                    lowest = i;
+
+                for (uint32_t d = 0; d < 8; ++d) {
+                    const uint32_t n = neighbour(x, y, d);
+                    if (n == NONE || map[n] < lower_bound) {
+                        push(i, map[i]);
+                        break;
+                    }
+                }
+            }
+        }
+    }
+
+    // Land all around, e.g. a world wide continent: it drains from its
+    // lowest point.
+    if (_queue.empty() && lowest != NONE)
+        push(lowest, map[lowest]);
+
+    // Lowest first. Land reached from a lower point can't be lower than it:
+    // depressions fill up to where the flood came in.
+    while (!_queue.empty())
+    {
+        pop_heap(_queue.begin(), _queue.end());
+        const Entry entry = _queue.back();
+        _queue.pop_back();
+
+        const uint32_t c = entry.index;
+        const uint32_t y = c / width, x = c - y * width;
+        _order.push_back(c);
+
+        for (uint32_t d = 0; d < 8; ++d) {
+            const uint32_t n = neighbour(x, y, d);
+            if (n == NONE || _reached[n] || map[n] < lower_bound)
+                continue;
+
+            _receivers[n] = c;
+            push(n, max(map[n], entry.height));
+        }
+    }
+
+    // Steepest descent on the filled surface. Points with no lower
+    // neighbour keep draining the way the flood came.
+    for (uint32_t k = 0; k < _order.size(); ++k)
+    {
+        const uint32_t c = _order[k];
+        const uint32_t y = c / width, x = c - y * width;
+
+        float steepest = 0.0f;
+        for (uint32_t d = 0; d < 8; ++d) {
+            const uint32_t n = neighbour(x, y, d);
+            if (n == NONE)
+                continue;
+
+            const float h = _reached[n] ? _filled[n] : map[n];
+            const float slope = (_filled[c] - h) * INV_DIST[d];
+            if (slope > steepest) {
+                steepest = slope;
+                _receivers[c] = n;
+            }
+        }
+    }
+
+    // Every point after its receiver: gather the water backwards.
+    for (uint32_t k = 0; k < _order.size(); ++k)
+        _accumulation[_order[k]] = 1;
+    for (uint32_t k = (uint32_t)_order.size(); k-- > 0;)
+    {
+        const uint32_t c = _order[k];
+        const uint32_t r = _receivers[c];
+        if (r != NONE && _reached[r])
+            _accumulation[r] += _accumulation[c];
+    }
+}
+
+void FlowAccumulation::erode(float* heights, float lower_bound) const
+{
+    for (uint32_t k = 0; k < _order.size(); ++k) {
+        const uint32_t i = _order[k];
+        const uint32_t upstream = min(_accumulation[i] - 1, FULL_FLOW);
+        heights[i] -= (heights[i] - lower_bound) * 0.2f * upstream / FULL_FLOW;
+    }
+}
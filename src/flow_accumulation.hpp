@@ -0,0 +1,125 @@
+/******************************************************************************
+ *  plate-tectonics, a plate tectonics simulation library
+ *  Copyright (C) 2012-2013 Lauri Viitanen
+ *  Copyright (C) 2014-2015 Federico Tomassetti, Bret Curtis
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, see http://www.gnu.org/licenses/
+ *****************************************************************************/
+
+#ifndef FLOW_ACCUMULATION_HPP
+#define FLOW_ACCUMULATION_HPP
+
+#include <vector>
+#include "utils.hpp"
+
+class TileOccupancy;
+
+/// Which way plates erode their crust.
+enum ErosionModel
+{
+    /// Rivers walk down from every local top, one step per round, eroding
+    /// the points they pass. The original model.
+    RIVER_EROSION,
+
+    /// Every point erodes in proportion to the water flowing through it,
+    /// given by a FlowAccumulation. Costs O(n log n) in the land points.
+    FLOW_ACCUMULATION_EROSION
+};
+
+/// D8 flow directions and flow accumulation of a plate's land.
+///
+/// Points lower than the bound are water: rain falling on the land flows
+/// to them, or off the edges of the plate that do not wrap around. A
+/// priority-flood from these outlets visits the land lowest first, filling
+/// depressions up to their spill point. Each land point then drains to its
+/// steepest lower neighbour among the eight on the filled surface; points
+/// of a filled depression or flat drain the way the flood reached them.
+/// The flood order lists every point after the one it drains to, so the
+/// accumulation takes one pass over it, backwards.
+class FlowAccumulation
+{
+public:
+    /// Receiver of the points whose water leaves the plate.
+    static const uint32_t NONE = 0xFFFFFFFF;
+
+    /// Upstream points that erode a point the most.
+    static const uint32_t FULL_FLOW = 16;
+
+    FlowAccumulation() : _width(0), _height(0) {}
+
+    /// Compute the flow of "map".
+    ///
+    /// @param  map         Heights, width * height of them.
+    /// @param  width       Width of the map in points.
+    /// @param  height      Height of the map in points.
+    /// @param  wrap_x      Rows wrap around, the map spans the world.
+    /// @param  wrap_y      Columns wrap around.
+    /// @param  lower_bound Points lower than this are water.
+    /// @param  tiles       Parts of the map that may hold land, when the
+    ///                     bound is above zero.
+    void compute(const float* map, uint32_t width, uint32_t height,
+                 bool wrap_x, bool wrap_y, float lower_bound,
+                 const TileOccupancy& tiles);
+
+    /// Lower each land point of the computed map towards the bound, in
+    /// proportion to the water flowing through it. Tops don't erode,
+    /// points draining FULL_FLOW others or more lose a fifth of their
+    /// height above the bound, as a river would take.
+    void erode(float* heights, float lower_bound) const;
+
+    uint32_t width() const { return _width; }
+    uint32_t height() const { return _height; }
+
+    /// Land points in the order the flood reached them, each after the
+    /// point it drains to.
+    const std::vector<uint32_t>& order() const { return _order; }
+
+    /// Point each point drains to: a land or water point, or NONE. Only
+    /// meaningful for land points.
+    const std::vector<uint32_t>& receivers() const { return _receivers; }
+
+    /// Number of land points whose water flows through each point, the
+    /// point itself included. Zero for water.
+    const std::vector<uint32_t>& accumulation() const { return _accumulation; }
+
+private:
+    /// A land point waiting in the flood, lowest filled height first and
+    /// earliest reached among equals.
+    struct Entry
+    {
+        float height;
+        uint32_t seq;
+        uint32_t index;
+
+        bool operator<(const Entry& other) const {
+            return height > other.height ||
+                   (height == other.height && seq > other.seq);
+        }
+    };
+
+    uint32_t neighbour(uint32_t x, uint32_t y, uint32_t d) const;
+    void push(uint32_t index, float height);
+
+    uint32_t _width, _height;
+    bool _wrap_x, _wrap_y;
+    uint32_t _seq;
+    std::vector<float> _filled;        ///< Heights with depressions filled.
+    std::vector<uint8_t> _reached;     ///< Land points the flood reached.
+    std::vector<uint32_t> _receivers;
+    std::vector<uint32_t> _accumulation;
+    std::vector<uint32_t> _order;
+    std::vector<Entry> _queue;         ///< Heap of the flood's front.
+};
+
+#endif
@@ -105,6 +105,12 @@ void Dimension::grow(uint32_t amountX, uint32_t amountY)
     _height += amountY;
 }
 
+void Dimension::shrink(uint32_t amountX, uint32_t amountY)
+{
+    _width -= amountX;
+    _height -= amountY;
+}
+
 //
 // WorldDimension
 //
@@ -166,6 +166,7 @@ public:
     bool contains(const float x, const float y) const;
     bool contains(const FloatPoint& p) const;
     void grow(uint32_t amountX, uint32_t amountY);
+    void shrink(uint32_t amountX, uint32_t amountY);
 protected:
     uint32_t _width;
     uint32_t _height;
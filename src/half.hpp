@@ -0,0 +1,110 @@
+/******************************************************************************
+ *  plate-tectonics, a plate tectonics simulation library
+ *  Copyright (C) 2012-2013 Lauri Viitanen
+ *  Copyright (C) 2014-2015 Federico Tomassetti, Bret Curtis
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, see http://www.gnu.org/licenses/
+ *****************************************************************************/
+
+#ifndef HALF_HPP
+#define HALF_HPP
+
+#include <cstring>
+#include "utils.hpp"
+
+#ifdef __F16C__
+#include <immintrin.h>
+#endif
+
+// Conversions between float and the IEEE 754 half precision format: 1 sign
+// bit, 5 exponent bits and 10 mantissa bits. They are written with integer
+// operations, so they give the same bits on every platform. Compilers that
+// target F16C (e.g. -mf16c) use its instructions, which round the same way.
+
+namespace Platec {
+
+/// Largest finite half, 65504.
+static const uint16_t HALF_MAX_BITS = 0x7BFF;
+
+/// Round a float to the nearest half, ties to even.
+///
+/// Values too large for a half become the largest finite half of the same
+/// sign instead of infinity. NaNs are not expected and not preserved.
+inline uint16_t floatToHalf(float value)
+{
+#ifdef __F16C__
+    value = value > 65504.0f ? 65504.0f : value < -65504.0f ? -65504.0f : value;
+    return _cvtss_sh(value, 0);
+#else
+    uint32_t f;
+    memcpy(&f, &value, sizeof(f));
+    const uint16_t sign = (uint16_t)((f >> 16) & 0x8000);
+    f &= 0x7FFFFFFF;
+
+    if (f >= 0x477FF000) // 65520 and up round to infinity: saturate.
+        return sign | HALF_MAX_BITS;
+
+    if (f < 0x38800000) // Below 2^-14 the half is subnormal.
+    {
+        // Adding 0.5 lines the subnormal's bits up with the low bits of the
+        // float's mantissa, the addition rounds them to nearest even.
+        const uint32_t magic_bits = 126u << 23;
+        float magnitude, magic;
+        memcpy(&magnitude, &f, sizeof(f));
+        memcpy(&magic, &magic_bits, sizeof(magic_bits));
+        magnitude += magic;
+        memcpy(&f, &magnitude, sizeof(f));
+        return sign | (uint16_t)(f - magic_bits);
+    }
+
+    // Rebias the exponent, then round the 13 dropped bits to nearest even.
+    const uint32_t odd = (f >> 13) & 1;
+    f += ((uint32_t)(15 - 127) << 23) + 0xFFF + odd;
+    return sign | (uint16_t)(f >> 13);
+#endif
+}
+
+/// Widen a half to the float of the same value.
+inline float halfToFloat(uint16_t half)
+{
+#ifdef __F16C__
+    return _cvtsh_ss(half);
+#else
+    const uint32_t shifted_exp = 0x7C00u << 13;
+    uint32_t f = (uint32_t)(half & 0x7FFF) << 13;
+    const uint32_t exp = f & shifted_exp;
+    f += (uint32_t)(127 - 15) << 23;
+
+    float value;
+    if (exp == shifted_exp) { // Infinity or NaN.
+        f += (uint32_t)(128 - 16) << 23;
+        memcpy(&value, &f, sizeof(f));
+    } else if (exp == 0) {    // Zero or subnormal: let the FPU normalize.
+        const uint32_t magic_bits = 113u << 23;
+        float magic;
+        memcpy(&magic, &magic_bits, sizeof(magic_bits));
+        f += 1u << 23;
+        memcpy(&value, &f, sizeof(f));
+        value -= magic;
+    } else {
+        memcpy(&value, &f, sizeof(f));
+    }
+
+    return (half & 0x8000) ? -value : value;
+#endif
+}
+
+}
+
+#endif
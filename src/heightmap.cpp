@@ -19,6 +19,40 @@
 
 #include "heightmap.hpp"
 
+#include <new>       // std::bad_alloc
 #include <stdexcept> // std::invalid_argument
+#include <stdlib.h>
+#if _WIN32 || _WIN64
+#include <malloc.h>
+#endif
 
 using namespace std;
+
+namespace Platec {
+
+void* alignedAlloc(size_t bytes)
+{
+    void* data = NULL;
+#if _WIN32 || _WIN64
+    data = _aligned_malloc(bytes, MATRIX_ALIGNMENT);
+#else
+    if (posix_memalign(&data, MATRIX_ALIGNMENT, bytes) != 0) {
+        data = NULL;
+    }
+#endif
+    if (data == NULL) {
+        throw bad_alloc();
+    }
+    return data;
+}
+
+void alignedFree(void* data)
+{
+#if _WIN32 || _WIN64
+    _aligned_free(data);
+#else
+    free(data);
+#endif
+}
+
+}
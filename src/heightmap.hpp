@@ -20,6 +20,7 @@
 #ifndef HEIGHTMAP_HPP
 #define HEIGHTMAP_HPP
 
+#include <algorithm> // std::fill, std::swap
 #include <stdexcept> // std::invalid_argument
 #include <cstring>
 #include <string>
@@ -29,59 +30,269 @@
 
 using namespace std;
 
+/// Move a row-major block of old_width * old_height values so that it sits at
+/// (d_lft, d_top) of a new_width * new_height block in the same buffer, then
+/// fill the margins around it. Neither side of the block may shrink.
+template <typename Value>
+void growRows(Value* data, uint32_t old_width, uint32_t old_height,
+              uint32_t new_width, uint32_t new_height,
+              uint32_t d_lft, uint32_t d_top, const Value& fill)
+{
+    ASSERT(old_width + d_lft <= new_width && old_height + d_top <= new_height,
+           "Block does not fit its new size");
+
+    // Every row lands at or after the place it was read from, so moving
+    // the bottom row first never overwrites a row that is still unread.
+    for (uint32_t j = old_height; j-- > 0;) {
+        memmove(&data[(d_top + j) * new_width + d_lft], &data[j * old_width],
+                old_width * sizeof(Value));
+    }
+
+    for (uint32_t j = 0; j < new_height; ++j) {
+        Value* row = &data[j * new_width];
+        if (j < d_top || j >= d_top + old_height) {
+            std::fill(row, row + new_width, fill);
+        } else {
+            std::fill(row, row + d_lft, fill);
+            std::fill(row + d_lft + old_width, row + new_width, fill);
+        }
+    }
+}
+
+/// Move the width * height block found at (x, y) of a row-major block
+/// old_width values wide to the start of the same buffer, its rows packed
+/// next to each other.
+template <typename Value>
+void cropRows(Value* data, uint32_t old_width, uint32_t x, uint32_t y,
+              uint32_t width, uint32_t height)
+{
+    ASSERT(width <= old_width, "Block does not fit its old size");
+
+    // Every row lands at or before the place it was read from, so moving
+    // the top row first never overwrites a row that is still unread.
+    for (uint32_t j = 0; j < height; ++j) {
+        memmove(&data[j * width], &data[(y + j) * old_width + x],
+                width * sizeof(Value));
+    }
+}
+
+namespace Platec {
+
+/// Alignment of matrix storage: a cache line on common hardware.
+static const size_t MATRIX_ALIGNMENT = 64;
+
+/// Allocate storage starting on a MATRIX_ALIGNMENT boundary.
+/// @exception  bad_alloc   Not enough memory.
+void* alignedAlloc(size_t bytes);
+
+/// Release storage allocated by alignedAlloc.
+void alignedFree(void* data);
+
+}
+
+/// Rectangular window into the storage of a matrix.
+///
+/// The view does not own the values, it is valid as long as the matrix it
+/// was taken from neither grows nor is destroyed.
+template <typename Value>
+class MatrixView
+{
+public:
+    MatrixView(Value* data, uint32_t width, uint32_t height, uint32_t stride)
+        : _data(data), _width(width), _height(height), _stride(stride) {}
+
+    Value& operator()(uint32_t x, uint32_t y) const
+    {
+        ASSERT(x < _width && y < _height, "Invalid coordinates");
+        return _data[y * _stride + x];
+    }
+    /// First value of row y, the rest of the row follows it contiguously.
+    Value* row(uint32_t y) const
+    {
+        ASSERT(y < _height, "Invalid row");
+        return _data + y * _stride;
+    }
+    uint32_t width() const
+    {
+        return _width;
+    }
+    uint32_t height() const
+    {
+        return _height;
+    }
+    /// Distance between the starts of two consecutive rows.
+    uint32_t stride() const
+    {
+        return _stride;
+    }
+private:
+    Value* _data;
+    uint32_t _width;
+    uint32_t _height;
+    uint32_t _stride;
+};
+
+/// Row-major matrix of plain values.
+///
+/// Values are copied and cleared bytewise, so Value must be trivially
+/// copyable. Storage is aligned to MATRIX_ALIGNMENT bytes unless the matrix
+/// was built around an array allocated by the caller.
 template <typename Value>
 class Matrix
 {
 public:
 
     Matrix(unsigned int width, unsigned int height)
-        : _width(width), _height(height)
+        : _width(width), _height(height), _adopted(false)
+    {
+        ASSERT(width != 0 && height != 0, "Matrix width and height should be greater than zero");
+        _area = width * height;
+        _capacity = _area;
+        _data = allocate(_capacity);
+    }
+    /// Matrix with every value set to "fill".
+    Matrix(unsigned int width, unsigned int height, const Value& fill)
+        : _width(width), _height(height), _adopted(false)
     {
         ASSERT(width != 0 && height != 0, "Matrix width and height should be greater than zero");
         _area = width * height;
-        _data = new Value[_area];
+        _capacity = _area;
+        _data = allocate(_capacity);
+        set_all(fill);
     }
+    /// Take over an array allocated with new[].
     Matrix(Value* data, unsigned int width, unsigned int height)
-        : _width(width), _height(height) {
+        : _width(width), _height(height), _adopted(true) {
         ASSERT(data != 0 && width != 0 && height != 0, "Invalid matrix data");
         _area = width * height;
+        _capacity = _area;
         _data = data;
     }
 
     Matrix(const Matrix<Value>& other)
-        : _width(other._width), _height(other._height), _area(other._area)
+        : _width(other._width), _height(other._height), _area(other._area),
+          _capacity(other._area), _adopted(false)
     {
-        _data = new Value[_area];
-        copy(other);
+        _data = allocate(_capacity);
+        memcpy(_data, other._data, _area * sizeof(Value));
     }
 
+#if __cplusplus >= 201103L
+    Matrix(Matrix<Value>&& other)
+        : _data(other._data), _width(other._width), _height(other._height),
+          _area(other._area), _capacity(other._capacity),
+          _adopted(other._adopted)
+    {
+        other._data = NULL;
+        other._width = other._height = other._area = other._capacity = 0;
+    }
+
+    Matrix<Value>& operator=(Matrix<Value>&& other)
+    {
+        swap(other);
+        return *this;
+    }
+#endif
+
     ~Matrix()
     {
-        delete[] _data;
+        release();
     }
 
     void set_all(const Value& value)
     {
-        // we cannot use memset to make it very general
-        const uint32_t my_area = area();
-        for (uint32_t i = 0; i < my_area; i++) {
-            _data[i] = value;
+        // Values made of one repeated byte, such as zero, are set with memset.
+        const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&value);
+        bool repeated = true;
+        for (size_t i = 1; i < sizeof(Value); i++) {
+            repeated &= bytes[i] == bytes[0];
+        }
+        if (repeated) {
+            memset(_data, bytes[0], _area * sizeof(Value));
+        } else {
+            std::fill(_data, _data + _area, value);
         }
     }
     void copy(const Matrix& other)
     {
-        if (_area != other._area) {
-            _width = other._width;
-            _height = other._height;
-            _area = other._area;
-            delete[] _data;
-            _data = new Value[_area];
+        if (_capacity < other._area) {
+            release();
+            _capacity = other._area;
+            _data = allocate(_capacity);
+            _adopted = false;
+        }
+        _width = other._width;
+        _height = other._height;
+        _area = other._area;
+        memcpy(_data, other._data, _area * sizeof(Value));
+    }
+
+    /// Exchange contents and storage with the other matrix.
+    void swap(Matrix& other)
+    {
+        std::swap(_data, other._data);
+        std::swap(_width, other._width);
+        std::swap(_height, other._height);
+        std::swap(_area, other._area);
+        std::swap(_capacity, other._capacity);
+        std::swap(_adopted, other._adopted);
+    }
+
+    /// Enlarge the matrix keeping its contents at (d_lft, d_top).
+    ///
+    /// Storage is over-allocated by half of the new area, so a matrix that
+    /// keeps growing in small steps mostly re-lays its rows out in place.
+    void grow(unsigned int width, unsigned int height,
+              unsigned int d_lft, unsigned int d_top, const Value& fill)
+    {
+        const uint32_t new_area = width * height;
+        if (new_area > _capacity) {
+            const uint32_t capacity = new_area + new_area / 2;
+            Value* data = allocate(capacity);
+            memcpy(data, _data, _area * sizeof(Value));
+            release();
+            _data = data;
+            _capacity = capacity;
+            _adopted = false;
         }
-        for (uint32_t i = 0; i < _area; i++) {
-            _data[i] = other._data[i];
+        growRows(_data, _width, _height, width, height, d_lft, d_top, fill);
+        _width = width;
+        _height = height;
+        _area = new_area;
+    }
+
+    /// Keep only the width * height values with top left corner at (x, y).
+    ///
+    /// Storage is given back when the matrix would use less than half of it.
+    void crop(unsigned int x, unsigned int y,
+              unsigned int width, unsigned int height)
+    {
+        ASSERT(width != 0 && height != 0 &&
+               x + width <= _width && y + height <= _height,
+               "Crop must be inside the matrix");
+        cropRows(_data, _width, x, y, width, height);
+        _width = width;
+        _height = height;
+        _area = width * height;
+        if (_area < _capacity / 2) {
+            Value* data = allocate(_area);
+            memcpy(data, _data, _area * sizeof(Value));
+            release();
+            _data = data;
+            _capacity = _area;
+            _adopted = false;
         }
     }
 
+    /// Window of width * height values with top left corner at (x, y).
+    MatrixView<Value> view(uint32_t x, uint32_t y,
+                           uint32_t width, uint32_t height) const
+    {
+        ASSERT(x + width <= _width && y + height <= _height,
+               "View must be inside the matrix");
+        return MatrixView<Value>(_data + y * _width + x, width, height, _width);
+    }
+
     inline const Value& set(unsigned int x, unsigned y, const Value& value)
     {
         ASSERT(x < _width && y < _height, "Invalid coordinates");
@@ -129,10 +340,27 @@ public:
     }
 private:
 
+    static Value* allocate(uint32_t count)
+    {
+        return static_cast<Value*>(Platec::alignedAlloc(count * sizeof(Value)));
+    }
+
+    void release()
+    {
+        if (_adopted) {
+            delete[] _data;
+        } else if (_data != NULL) {
+            Platec::alignedFree(_data);
+        }
+        _data = NULL;
+    }
+
     Value* _data;
     unsigned int _width;
     unsigned int _height;
     unsigned int _area;
+    unsigned int _capacity; ///< Number of values the storage can hold.
+    bool _adopted; ///< Storage came from the caller's new[].
 };
 
 typedef Matrix<float> HeightMap;
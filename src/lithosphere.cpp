@@ -22,6 +22,7 @@
 #include "sqrdmd.hpp"
 #include "simplexnoise.hpp"
 #include "noise.hpp"
+#include "parallel.hpp"
 
 #include <cfloat>
 #include <cmath>
@@ -30,6 +31,7 @@
 #include <vector>
 #include <cstring>
 #include <iostream>
+#include <algorithm>
 
 #define BOOL_REGENERATE_CRUST   1
 
@@ -50,6 +52,20 @@ uint32_t findBound(const uint32_t* map, uint32_t length, uint32_t x0, uint32_t y
                    int dx, int dy);
 uint32_t findPlate(plate** plates, float x, float y, uint32_t num_plates);
 
+// Orders plate indices by decreasing bounding box area.
+class LargerPlateFirst
+{
+public:
+    LargerPlateFirst(plate** plates) : _plates(plates) {}
+    bool operator()(uint32_t a, uint32_t b) const {
+        const uint32_t area_a = _plates[a]->getWidth() * _plates[a]->getHeight();
+        const uint32_t area_b = _plates[b]->getWidth() * _plates[b]->getHeight();
+        return area_a > area_b || (area_a == area_b && a < b);
+    }
+private:
+    plate** _plates;
+};
+
 WorldPoint lithosphere::randomPosition()
 {
     return WorldPoint(
@@ -70,11 +86,14 @@ void lithosphere::createSlowNoise(float* tmp, const WorldDimension& tmpDim)
 
 lithosphere::lithosphere(long seed, uint32_t width, uint32_t height, float sea_level,
                          uint32_t _erosion_period, float _folding_ratio, uint32_t aggr_ratio_abs,
-                         float aggr_ratio_rel, uint32_t num_cycles, uint32_t _max_plates) throw(invalid_argument) :
+                         float aggr_ratio_rel, uint32_t num_cycles, uint32_t _max_plates,
+                         uint32_t _num_threads) throw(invalid_argument) :
     hmap(width, height),
     amap(width, height),
     imap(width, height),
-    prev_imap(width, height),
+    lmap(width, height),
+    imap_view(1, 1),
+    amap_view(1, 1),
     plates(0),
     plate_indices_found(_max_plates),
     plate_areas(_max_plates),
@@ -87,6 +106,14 @@ lithosphere::lithosphere(long seed, uint32_t width, uint32_t height, float sea_l
     max_cycles(num_cycles),
     max_plates(_max_plates),
     num_plates(0),
+    num_threads(_num_threads),
+    compaction_ratio(0),
+    erosion_model(RIVER_EROSION),
+    world_erosion(false),
+    coverage((width + 63) / 64 * height),
+    coverage_words((width + 63) / 64),
+    world_crust(1, 1),
+    world_eroded(1, 1),
     _worldDimension(width, height),
     _randsource(seed),
     _steps(0)
@@ -94,6 +121,14 @@ lithosphere::lithosphere(long seed, uint32_t width, uint32_t height, float sea_l
     if (width < 5 || height < 5) {
         throw runtime_error("Width and height should be >=5");
     }
+    if (_max_plates >= NO_PLATE) {
+        throw invalid_argument("Too many plates for the plate index map");
+    }
+    // Ages are iteration counts, the largest of which follows the creation
+    // of the plates: see createPlates.
+    if ((WorldAge)(_max_plates + MAX_BUOYANCY_AGE) != _max_plates + MAX_BUOYANCY_AGE) {
+        throw invalid_argument("Too many plates for the age map");
+    }
 
     WorldDimension tmpDim = WorldDimension(width+1, height+1);
     const uint32_t A = tmpDim.getArea();
@@ -264,8 +299,9 @@ void lithosphere::createPlates()
 
         // Initialize "Free plate center position" lookup table.
         // This way two plate centers will never be identical.
+        vector<uint32_t> free_points(map_area);
         for (uint32_t i = 0; i < map_area; ++i)
-            imap[i] = i;
+            free_points[i] = i;
 
         // Select N plate centers from the global map.
 
@@ -274,7 +310,7 @@ void lithosphere::createPlates()
             plateArea& area = plate_areas[i];
 
             // Randomly select an unused plate origin.
-            const uint32_t p = imap[(uint32_t)_randsource.next() % (map_area - i)];
+            const uint32_t p = free_points[(uint32_t)_randsource.next() % (map_area - i)];
             const uint32_t y = _worldDimension.yFromIndex(p);
             const uint32_t x = _worldDimension.xFromIndex(p);
 
@@ -286,10 +322,10 @@ void lithosphere::createPlates()
             area.border.push_back(p); // ...and mark it as border.
 
             // Overwrite used entry with last unused entry in array.
-            imap[p] = imap[map_area - i - 1];
+            free_points[p] = free_points[map_area - i - 1];
         }
 
-        imap.set_all(0xFFFFFFFF);
+        imap.set_all(NO_PLATE);
 
         growPlates();
 
@@ -306,23 +342,30 @@ void lithosphere::createPlates()
             area.hgt = _worldDimension.yCap(area.hgt);
 
             const uint32_t x0 = area.lft;
-            const uint32_t x1 = 1 + x0 + area.wdt;
             const uint32_t y0 = area.top;
-            const uint32_t y1 = 1 + y0 + area.hgt;
-            const uint32_t width = x1 - x0;
-            const uint32_t height = y1 - y0;
-            float* pmap = new float[width * height];
+            const uint32_t width = 1 + area.wdt;
+            const uint32_t height = 1 + area.hgt;
+            HeightMap pmap(width, height);
 
             // Copy plate's height data from global map into local map.
-            for (uint32_t y = y0, j = 0; y < y1; ++y) {
-                for (uint32_t x = x0; x < x1; ++x, ++j) {
-                    uint32_t k = _worldDimension.normalizedIndexOf(x, y);
-                    pmap[j] = hmap[k] * (imap[k] == i);
+            const Platec::WrappedRect rect(_worldDimension, x0, y0, width, height);
+            for (uint32_t v = 0; v < rect.rowSpans(); ++v) {
+                const Platec::WrappedSpan& rows = rect.rowSpan(v);
+                for (uint32_t r = 0; r < rows.length; ++r) {
+                    for (uint32_t c = 0; c < rect.columnSpans(); ++c) {
+                        const Platec::WrappedSpan& cols = rect.columnSpan(c);
+                        float* dst = &pmap[(rows.plate + r) * width + cols.plate];
+                        const uint32_t k = _worldDimension.indexOf(cols.world, rows.world + r);
+                        const float* h = &hmap[k];
+                        const PlateIndex* owner = &imap[k];
+
+                        for (uint32_t x = 0; x < cols.length; ++x)
+                            dst[x] = h[x] * (owner[x] == i);
+                    }
                 }
             }
-            // Create plate.
-            // MK: The pmap array becomes owned by map, do not delete it
-            plates[i] = new plate(_randsource.next(), pmap, width, height, x0, y0, i, _worldDimension);
+            // Create plate, it takes over pmap's storage.
+            plates[i] = new plate(_randsource.next(), pmap, x0, y0, i, _worldDimension);
         }
 
         iter_count = num_plates + MAX_BUOYANCY_AGE;
@@ -343,7 +386,7 @@ uint32_t lithosphere::getPlateCount() const throw()
 
 const uint32_t* lithosphere::getAgemap() const throw()
 {
-    return amap.raw_data();
+    return widenedMap(amap, amap_view);
 }
 
 float* lithosphere::getTopography() const throw()
@@ -360,14 +403,14 @@ bool lithosphere::isFinished() const
 // Move some crust from the SMALLER plate onto LARGER one.
 void lithosphere::resolveJuxtapositions(const uint32_t& i, const uint32_t& j, const uint32_t& k,
                                         const uint32_t& x_mod, const uint32_t& y_mod,
-                                        const float*& this_map, const uint32_t*& this_age, uint32_t& continental_collisions)
+                                        CrustView& this_map, CrustAgeView& this_age, uint32_t& continental_collisions)
 {
     ASSERT(i<num_plates, "Given invalid plate index");
 
     // Record collisions to both plates. This also creates
     // continent segment at the collided location to plates.
-    uint32_t this_area = plates[i]->addCollision(x_mod, y_mod);
-    uint32_t prev_area = plates[imap[k]]->addCollision(x_mod, y_mod);
+    uint32_t this_area = plates[i]->addCollision(j);
+    uint32_t prev_area = plates[imap[k]]->addCollision(lmap[k]);
 
     if (this_area < prev_area)
     {
@@ -376,12 +419,11 @@ void lithosphere::resolveJuxtapositions(const uint32_t& i, const uint32_t& j, co
 
         // Give some...
         hmap[k] += coll.crust;
-        plates[imap[k]]->setCrust(x_mod, y_mod, hmap[k],
-                                  this_age[j]);
+        plates[imap[k]]->setCrust(lmap[k], hmap[k], this_age[j]);
 
         // And take some.
-        plates[i]->setCrust(x_mod, y_mod, this_map[j] *
-                            (1.0 - folding_ratio), this_age[j]);
+        plates[i]->setCrust(j, this_map[j] * (1.0 - folding_ratio),
+                            this_age[j]);
 
         // Add collision to the earlier plate's list.
         collisions[i].push_back(coll);
@@ -392,22 +434,396 @@ void lithosphere::resolveJuxtapositions(const uint32_t& i, const uint32_t& j, co
         plateCollision coll(i, x_mod, y_mod,
                             hmap[k] * folding_ratio);
 
-        plates[i]->setCrust(x_mod, y_mod,
-                            this_map[j]+coll.crust, amap[k]);
+        plates[i]->setCrust(j, this_map[j]+coll.crust, amap[k]);
 
-        plates[imap[k]]->setCrust(x_mod, y_mod, hmap[k]
-                                  * (1.0 - folding_ratio), amap[k]);
+        plates[imap[k]]->setCrust(lmap[k], hmap[k] * (1.0 - folding_ratio),
+                                  amap[k]);
 
         collisions[imap[k]].push_back(coll);
         ++continental_collisions;
 
         // Give the location to the larger plate.
+        --plate_indices_found[imap[k]];
+        ++plate_indices_found[i];
         hmap[k] = this_map[j];
         imap[k] = i;
+        lmap[k] = j;
         amap[k] = this_age[j];
     }
 }
 
+// Applies the side effects of the overlay immediately, as they happen.
+class lithosphere::directOverlay
+{
+public:
+    directOverlay(lithosphere& litho, uint32_t& continental_collisions)
+        : _litho(litho), _continental_collisions(continental_collisions) {}
+
+    void setCrust(uint32_t p, uint32_t index, float z, uint32_t t) {
+        _litho.plates[p]->setCrust(index, z, t);
+    }
+    void claim(uint32_t p, uint32_t n) {
+        _litho.plate_indices_found[p] += n;
+    }
+    void release(uint32_t p) {
+        --_litho.plate_indices_found[p];
+    }
+    void subduct(uint32_t p, const plateCollision& coll) {
+        _litho.subductions[p].push_back(coll);
+    }
+    void juxtapose(uint32_t i, uint32_t j, uint32_t k,
+                   uint32_t x_mod, uint32_t y_mod,
+                   CrustView& this_map, CrustAgeView& this_age) {
+        _litho.resolveJuxtapositions(i, j, k, x_mod, y_mod, this_map,
+                                     this_age, _continental_collisions);
+    }
+    bool deferred(uint32_t k) const {
+        return false;
+    }
+    void defer(uint32_t i, uint32_t j, uint32_t k) {
+        ASSERT(false, "Nothing is deferred when overlaying directly");
+    }
+
+private:
+    lithosphere& _litho;
+    uint32_t& _continental_collisions;
+};
+
+// Used while the world is overlaid one band of rows per thread.
+// Anything whose outcome depends on the order in which the bands are
+// processed is written into the band's event list and applied later:
+// changes of plate mass (floating point sums) and of the young crust lists
+// (shared by all bands), subductions (their order drives the random numbers
+// of addCrustBySubduction) and continental collisions (they create
+// continent segments reaching over many rows).
+// Once a location has been deferred it stays so for the rest of the pass.
+class lithosphere::bandOverlay
+{
+public:
+    bandOverlay(lithosphere& litho, vector<uint32_t>& found)
+        : events(0), _litho(litho), _found(found) {}
+
+    vector<overlayEvent>* events; ///< Where the current plate's events go.
+
+    void setCrust(uint32_t p, uint32_t index, float z, uint32_t t) {
+        z = z < 0 ? 0 : z;
+        plate& target = *_litho.plates[p];
+        const uint32_t age = target.getCrustTimestamp(index);
+        const float old_crust = target.replaceCrust(index, z, t);
+        const bool aged = target.getCrustTimestamp(index) != age;
+        events->push_back(overlayEvent(overlayEvent::MASS, p, index, aged,
+                                       old_crust, (float)Crust(z)));
+    }
+    void claim(uint32_t p, uint32_t n) {
+        _found[p] += n;
+    }
+    void release(uint32_t p) {
+        --_found[p];
+    }
+    void subduct(uint32_t p, const plateCollision& coll) {
+        events->push_back(overlayEvent(overlayEvent::SUBDUCTION, p,
+                                       coll.index, coll.wx + coll.wy *
+                                       _litho._worldDimension.getWidth(),
+                                       coll.crust, 0));
+    }
+    void juxtapose(uint32_t i, uint32_t j, uint32_t k,
+                   uint32_t x_mod, uint32_t y_mod,
+                   CrustView& this_map, CrustAgeView& this_age) {
+        events->push_back(overlayEvent(overlayEvent::JUXTAPOSITION, i, j, k, 0, 0));
+        _litho.overlay_deferred[k] = 1;
+    }
+    bool deferred(uint32_t k) const {
+        return _litho.overlay_deferred[k] != 0;
+    }
+    void defer(uint32_t i, uint32_t j, uint32_t k) {
+        events->push_back(overlayEvent(overlayEvent::PIXEL, i, j, k, 0, 0));
+    }
+
+private:
+    lithosphere& _litho;
+    vector<uint32_t>& _found; ///< Locations claimed by each plate.
+};
+
+// Put the crust of plate "i" at world location "k" on the world map,
+// resolving the conflict with the plate already there, if any.
+template <class Sink>
+void lithosphere::overlayPixel(Sink& sink, uint32_t i, uint32_t j, uint32_t k,
+                               uint32_t x_mod, uint32_t y_mod,
+                               CrustView& this_map, CrustAgeView& this_age,
+                               uint32_t& oceanic_collisions)
+{
+    if (!covered(x_mod, y_mod)) // No one here yet?
+    {
+        // This plate becomes the "owner" of current location
+        // if it is the first plate to have crust on it.
+        hmap[k] = this_map[j];
+        imap[k] = i;
+        lmap[k] = j;
+        amap[k] = this_age[j];
+        cover(x_mod, y_mod);
+        sink.claim(i, 1);
+
+        return;
+    }
+
+    // DO NOT ACCEPT HEIGHT EQUALITY! Equality leads to subduction
+    // of shore that 's barely above sea level. It's a lot less
+    // serious problem to treat very shallow waters as continent...
+    const bool prev_is_oceanic = hmap[k] < CONTINENTAL_BASE;
+    const bool this_is_oceanic = this_map[j] < CONTINENTAL_BASE;
+
+    const uint32_t prev_timestamp = plates[imap[k]]->getCrustTimestamp(lmap[k]);
+    const uint32_t this_timestamp = this_age[j];
+    const uint32_t prev_is_bouyant = (hmap[k] > this_map[j]) |
+                                     ((hmap[k] + 2 * FLT_EPSILON > this_map[j]) &
+                                      (hmap[k] < 2 * FLT_EPSILON + this_map[j]) &
+                                      (prev_timestamp >= this_timestamp));
+
+    // Handle subduction of oceanic crust as special case.
+    if (this_is_oceanic & prev_is_bouyant) {
+        // This plate will be the subducting one.
+        // The level of effect that subduction has
+        // is directly related to the amount of water
+        // on top of the subducting plate.
+        const float sediment = SUBDUCT_RATIO * OCEANIC_BASE *
+                               (CONTINENTAL_BASE - this_map[j]) /
+                               CONTINENTAL_BASE;
+
+        // Save collision to the receiving plate's list.
+        plateCollision coll(i, x_mod, y_mod, sediment);
+        sink.subduct(imap[k], coll);
+        ++oceanic_collisions;
+
+        // Remove subducted oceanic lithosphere from plate.
+        // This is crucial for
+        // a) having correct amount of colliding crust (below)
+        // b) protecting subducted locations from receiving
+        //    crust from other subductions/collisions.
+        sink.setCrust(i, j, this_map[j] - OCEANIC_BASE, this_timestamp);
+
+        if (this_map[j] <= 0)
+            return; // Nothing more to collide.
+    } else if (prev_is_oceanic) {
+        const float sediment = SUBDUCT_RATIO * OCEANIC_BASE *
+                               (CONTINENTAL_BASE - hmap[k]) /
+                               CONTINENTAL_BASE;
+
+        plateCollision coll(imap[k], x_mod, y_mod, sediment);
+        sink.subduct(i, coll);
+        ++oceanic_collisions;
+
+        sink.setCrust(imap[k], lmap[k], hmap[k] - OCEANIC_BASE,
+                      prev_timestamp);
+        hmap[k] -= OCEANIC_BASE;
+
+        if (hmap[k] <= 0) {
+            sink.release(imap[k]);
+            sink.claim(i, 1);
+            imap[k] = i;
+            lmap[k] = j;
+            hmap[k] = this_map[j];
+            amap[k] = this_age[j];
+
+            return;
+        }
+    }
+
+    sink.juxtapose(i, j, k, x_mod, y_mod, this_map, this_age);
+}
+
+// Parts of the circular range [b, b + v[ found within [a, a + w[, relative
+// to a. At most two, stored as [start, end[ pairs.
+static uint32_t wrappedOverlap(uint32_t a, uint32_t w, uint32_t b, uint32_t v,
+                               uint32_t length, uint32_t* found)
+{
+    const uint32_t d = (b % length + length - a % length) % length;
+    uint32_t n = 0;
+
+    if (d < w) {
+        found[n++] = d;
+        found[n++] = min(d + v, w);
+    }
+    if (d + v > length) {
+        found[n++] = 0;
+        found[n++] = min(d + v - length, w);
+    }
+
+    return n / 2;
+}
+
+// Broadphase of the overlay. Plates are stamped on the world in index
+// order, so a location of plate "i" can only be contested if one of the
+// plates before it reaches there. Record, in plate "i"'s coordinates, the
+// rectangles where the bounds of the earlier plates intersect its own.
+void lithosphere::findOverlaps()
+{
+    const uint32_t world_width = _worldDimension.getWidth();
+    const uint32_t world_height = _worldDimension.getHeight();
+
+    overlap_rects.resize(num_plates);
+    for (uint32_t i = 0; i < num_plates; ++i)
+    {
+        vector<uint32_t>& rects = overlap_rects[i];
+        rects.clear();
+
+        for (uint32_t p = 0; p < i; ++p)
+        {
+            uint32_t xs[4], ys[4];
+            const uint32_t nx = wrappedOverlap(plates[i]->getLeftAsUint(),
+                                               plates[i]->getWidth(),
+                                               plates[p]->getLeftAsUint(),
+                                               plates[p]->getWidth(),
+                                               world_width, xs);
+            const uint32_t ny = wrappedOverlap(plates[i]->getTopAsUint(),
+                                               plates[i]->getHeight(),
+                                               plates[p]->getTopAsUint(),
+                                               plates[p]->getHeight(),
+                                               world_height, ys);
+
+            for (uint32_t a = 0; a < nx; ++a)
+                for (uint32_t b = 0; b < ny; ++b) {
+                    rects.push_back(xs[2 * a]);
+                    rects.push_back(xs[2 * a + 1]);
+                    rects.push_back(ys[2 * b]);
+                    rects.push_back(ys[2 * b + 1]);
+                }
+        }
+    }
+}
+
+// Columns of plate's row that some earlier plate might already occupy, as
+// sorted and disjoint [start, end[ pairs.
+void lithosphere::findConflictSpans(uint32_t i, uint32_t row,
+                                    vector<uint32_t>& spans) const
+{
+    const vector<uint32_t>& rects = overlap_rects[i];
+    spans.clear();
+
+    for (uint32_t r = 0; r < rects.size(); r += 4)
+    {
+        if (row < rects[r + 2] || row >= rects[r + 3])
+            continue;
+
+        uint32_t start = rects[r], end = rects[r + 1];
+
+        // Merge with every span it touches, keeping the list sorted.
+        uint32_t s = 0;
+        while (s < spans.size() && spans[s + 1] < start)
+            s += 2;
+        uint32_t e = s;
+        while (e < spans.size() && spans[e] <= end) {
+            start = min(start, spans[e]);
+            end = max(end, spans[e + 1]);
+            e += 2;
+        }
+        spans.erase(spans.begin() + s, spans.begin() + e);
+        spans.insert(spans.begin() + s, 2, start);
+        spans[s + 1] = end;
+    }
+}
+
+// Copy "n" locations of plate "i", starting at "j", over a part of the
+// world at "k" nobody else has reached yet. Empty locations are left alone
+// just like overlayPixel's callers do. Returns the number of locations
+// claimed.
+uint32_t lithosphere::copySpan(uint32_t i, uint32_t j, uint32_t k, uint32_t n,
+                           const CrustView& this_map, const CrustAgeView& this_age)
+{
+    float* h = &hmap[k];
+    PlateIndex* o = &imap[k];
+    uint32_t* l = &lmap[k];
+    WorldAge* a = &amap[k];
+
+    uint32_t claimed = 0;
+    for (uint32_t x = 0; x < n; ++x)
+    {
+        const bool crust = !(this_map[j + x] < 2 * FLT_EPSILON);
+        h[x] = crust ? (float)this_map[j + x] : h[x];
+        o[x] = crust ? i : o[x];
+        l[x] = crust ? j + x : l[x];
+        a[x] = crust ? this_age[j + x] : a[x];
+        claimed += crust;
+    }
+
+    if (claimed > 0)
+    {
+        const uint32_t world_width = _worldDimension.getWidth();
+        const uint32_t first = k % world_width;
+        uint64_t* row = &coverage[k / world_width * coverage_words];
+        for (uint32_t x = 0; x < n; ++x)
+            row[(first + x) >> 6] |= (uint64_t)!(this_map[j + x] < 2 * FLT_EPSILON) <<
+                                     ((first + x) & 63);
+    }
+
+    return claimed;
+}
+
+// Stamp one row of plate "i" on world row "y_mod". Only the columns that
+// an earlier plate might have claimed run the full conflict logic, the
+// rest is copied over in bulk.
+template <class Sink>
+void lithosphere::overlayRow(Sink& sink, uint32_t i,
+                             const Platec::WrappedRect& rect, uint32_t row,
+                             uint32_t y_mod, vector<uint32_t>& spans,
+                             uint32_t& oceanic_collisions)
+{
+    const uint32_t y_width = y_mod * _worldDimension.getWidth();
+    const uint32_t row_start = row * plates[i]->getWidth();
+
+    CrustView this_map;
+    CrustAgeView this_age;
+    plates[i]->getMap(&this_map, &this_age);
+
+    findConflictSpans(i, row, spans);
+
+    uint32_t s = 0;
+    for (uint32_t c = 0; c < rect.columnSpans(); ++c)
+    {
+        const Platec::WrappedSpan& cols = rect.columnSpan(c);
+        const uint32_t to_world = cols.world - cols.plate;
+        const uint32_t span_end = cols.plate + cols.length;
+
+        // Empty tiles of the plate have nothing to stamp.
+        for (uint32_t x, end = cols.plate;
+                plates[i]->getOccupancy().nextRun(row, end, span_end, x, end);)
+        {
+            while (x < end)
+            {
+                // A conflict span may go on in the next column span.
+                while (s < spans.size() && spans[s + 1] <= x)
+                    s += 2;
+                const uint32_t conflict_begin = s < spans.size() ?
+                                                min(max(spans[s], x), end) : end;
+                const uint32_t conflict_end = s < spans.size() ?
+                                              min(spans[s + 1], end) : end;
+
+                sink.claim(i, copySpan(i, row_start + x, y_width + x + to_world,
+                                       conflict_begin - x, this_map, this_age));
+
+                for (x = conflict_begin; x < conflict_end; ++x)
+                {
+                    const uint32_t j = row_start + x;
+                    const uint32_t x_mod = x + to_world;
+                    const uint32_t k = x_mod + y_width;
+
+                    if (this_map[j] < 2 * FLT_EPSILON) // No crust here...
+                        continue;
+
+                    if (sink.deferred(k)) {
+                        sink.defer(i, j, k);
+                        continue;
+                    }
+
+                    overlayPixel(sink, i, j, k, x_mod, y_mod, this_map, this_age,
+                                 oceanic_collisions);
+                }
+
+                x = conflict_end;
+            }
+        }
+    }
+}
+
 // Update height and plate index maps.
 // Doing it plate by plate is much faster than doing it index wise:
 // Each plate's map's memory area is accessed sequentially and only
@@ -417,121 +833,166 @@ void lithosphere::updateHeightAndPlateIndexMaps(const uint32_t& map_area,
         uint32_t& oceanic_collisions,
         uint32_t& continental_collisions)
 {
-    uint32_t world_width = _worldDimension.getWidth();
-    uint32_t world_height = _worldDimension.getHeight();
+    findOverlaps();
+    fill(plate_indices_found.begin(), plate_indices_found.end(), 0);
+
+    const uint32_t threads = Platec::threadCount(num_threads);
+    if (threads > 1 && num_plates > 1) {
+        overlayInBands(threads, oceanic_collisions, continental_collisions);
+        return;
+    }
+
+    directOverlay sink(*this, continental_collisions);
+    vector<uint32_t> spans;
     hmap.set_all(0);
-    imap.set_all(0xFFFFFFFF);
+    fill(coverage.begin(), coverage.end(), 0);
     for (uint32_t i = 0; i < num_plates; ++i)
     {
-        const uint32_t x0 = plates[i]->getLeftAsUint();
-        const uint32_t y0 = plates[i]->getTopAsUint();
-        const uint32_t x1 = x0 + plates[i]->getWidth();
-        const uint32_t y1 = y0 + plates[i]->getHeight();
+        const Platec::WrappedRect rect(_worldDimension,
+                                       plates[i]->getLeftAsUint(),
+                                       plates[i]->getTopAsUint(),
+                                       plates[i]->getWidth(),
+                                       plates[i]->getHeight());
 
-        const float*  this_map;
-        const uint32_t* this_age;
-        plates[i]->getMap(&this_map, &this_age);
+        for (uint32_t v = 0; v < rect.rowSpans(); ++v)
+        {
+            const Platec::WrappedSpan& rows = rect.rowSpan(v);
+            for (uint32_t r = 0; r < rows.length; ++r)
+                overlayRow(sink, i, rect, rows.plate + r, rows.world + r,
+                           spans, oceanic_collisions);
+        }
+    }
+}
 
-        uint32_t x_mod_start = (x0 + world_width) % world_width;
-        uint32_t y_mod = (y0 + world_height) % world_height;
+// Same as the serial overlay, but the world is cut in bands of rows which
+// are processed concurrently, each band stamping all the plates in index
+// order. Order dependent side effects are collected per band, plate and
+// part of the plate (above and below the world's bottom edge) and then
+// replayed in exactly the order the serial loop would have produced them.
+void lithosphere::overlayInBands(uint32_t threads, uint32_t& oceanic_collisions,
+                                 uint32_t& continental_collisions)
+{
+    const uint32_t world_height = _worldDimension.getHeight();
+    const uint32_t num_bands = min(world_height, 4 * threads);
 
-        // Copy first part of plate onto world map.
-        // MK: These loops are ugly, but using modulus in here is a hog
-        for (uint32_t y = y0, j = 0; y < y1; ++y,
-                y_mod = ++y_mod >= world_height ? y_mod - world_height : y_mod)
-        {
-            const uint32_t y_width = y_mod * world_width;
-            uint32_t x_mod = x_mod_start;
+    overlay_deferred.resize(_worldDimension.getArea());
+    overlay_events.resize(num_bands * num_plates * 2);
+    overlay_found.resize(num_bands);
 
-            for (uint32_t x = x0; x < x1; ++x, ++j,
-                    x_mod = ++x_mod >= world_width ? x_mod - world_width : x_mod)
-            {
-                const uint32_t k = x_mod + y_width;
+    Platec::ParallelError error;
+    uint32_t band_collisions = 0;
 
-                if (this_map[j] < 2 * FLT_EPSILON) // No crust here...
-                    continue;
+    #pragma omp parallel for schedule(dynamic, 1) num_threads(threads) reduction(+:band_collisions)
+    for (int band = 0; band < (int)num_bands; ++band)
+    {
+        try {
+            const uint32_t row_begin = band * world_height / num_bands;
+            const uint32_t row_end = (band + 1) * world_height / num_bands;
+            overlayBand(band, row_begin, row_end, band_collisions);
+        } catch (const exception& e) {
+            error.record(e.what());
+        }
+    }
 
-                if (imap[k] >= num_plates) // No one here yet?
-                {
-                    // This plate becomes the "owner" of current location
-                    // if it is the first plate to have crust on it.
-                    hmap[k] = this_map[j];
-                    imap[k] = i;
-                    amap[k] = this_age[j];
+    error.rethrow();
+    oceanic_collisions += band_collisions;
+    for (uint32_t band = 0; band < num_bands; ++band)
+        for (uint32_t i = 0; i < num_plates; ++i)
+            plate_indices_found[i] += overlay_found[band][i];
 
-                    continue;
-                }
+    // Replay the recorded events in serial order.
+    const uint32_t world_width = _worldDimension.getWidth();
+    directOverlay sink(*this, continental_collisions);
+    for (uint32_t i = 0; i < num_plates; ++i)
+    {
+        CrustView this_map;
+        CrustAgeView this_age;
+        plates[i]->getMap(&this_map, &this_age);
+
+        for (uint32_t part = 0; part < 2; ++part)
+            for (uint32_t band = 0; band < num_bands; ++band)
+            {
+                vector<overlayEvent>& events =
+                    overlay_events[(band * num_plates + i) * 2 + part];
 
-                // DO NOT ACCEPT HEIGHT EQUALITY! Equality leads to subduction
-                // of shore that 's barely above sea level. It's a lot less
-                // serious problem to treat very shallow waters as continent...
-                const bool prev_is_oceanic = hmap[k] < CONTINENTAL_BASE;
-                const bool this_is_oceanic = this_map[j] < CONTINENTAL_BASE;
-
-                const uint32_t prev_timestamp = plates[imap[k]]->
-                                                getCrustTimestamp(x_mod, y_mod);
-                const uint32_t this_timestamp = this_age[j];
-                const uint32_t prev_is_bouyant = (hmap[k] > this_map[j]) |
-                                                 ((hmap[k] + 2 * FLT_EPSILON > this_map[j]) &
-                                                  (hmap[k] < 2 * FLT_EPSILON + this_map[j]) &
-                                                  (prev_timestamp >= this_timestamp));
-
-                // Handle subduction of oceanic crust as special case.
-                if (this_is_oceanic & prev_is_bouyant) {
-                    // This plate will be the subducting one.
-                    // The level of effect that subduction has
-                    // is directly related to the amount of water
-                    // on top of the subducting plate.
-                    const float sediment = SUBDUCT_RATIO * OCEANIC_BASE *
-                                           (CONTINENTAL_BASE - this_map[j]) /
-                                           CONTINENTAL_BASE;
-
-                    // Save collision to the receiving plate's list.
-                    plateCollision coll(i, x_mod, y_mod, sediment);
-                    subductions[imap[k]].push_back(coll);
-                    ++oceanic_collisions;
-
-                    // Remove subducted oceanic lithosphere from plate.
-                    // This is crucial for
-                    // a) having correct amount of colliding crust (below)
-                    // b) protecting subducted locations from receiving
-                    //    crust from other subductions/collisions.
-                    plates[i]->setCrust(x_mod, y_mod, this_map[j] -
-                                        OCEANIC_BASE, this_timestamp);
-
-                    if (this_map[j] <= 0)
-                        continue; // Nothing more to collide.
-                } else if (prev_is_oceanic) {
-                    const float sediment = SUBDUCT_RATIO * OCEANIC_BASE *
-                                           (CONTINENTAL_BASE - hmap[k]) /
-                                           CONTINENTAL_BASE;
-
-                    plateCollision coll(imap[k], x_mod, y_mod, sediment);
-                    subductions[i].push_back(coll);
-                    ++oceanic_collisions;
-
-                    plates[imap[k]]->setCrust(x_mod, y_mod, hmap[k] -
-                                              OCEANIC_BASE, prev_timestamp);
-                    hmap[k] -= OCEANIC_BASE;
-
-                    if (hmap[k] <= 0) {
-                        imap[k] = i;
-                        hmap[k] = this_map[j];
-                        amap[k] = this_age[j];
+                for (uint32_t e = 0; e < events.size(); ++e)
+                {
+                    const overlayEvent& ev = events[e];
+                    const uint32_t x_mod = ev.k % world_width;
+                    const uint32_t y_mod = ev.k / world_width;
 
-                        continue;
+                    switch (ev.kind)
+                    {
+                    case overlayEvent::MASS:
+                        plates[ev.plate]->updateMass(ev.a, ev.b);
+                        if (ev.k)
+                            plates[ev.plate]->listYoungPoint(ev.j);
+                        break;
+                    case overlayEvent::SUBDUCTION:
+                        subductions[ev.plate].push_back(
+                            plateCollision(ev.j, x_mod, y_mod, ev.a));
+                        break;
+                    case overlayEvent::JUXTAPOSITION:
+                        resolveJuxtapositions(i, ev.j, ev.k, x_mod, y_mod,
+                                              this_map, this_age,
+                                              continental_collisions);
+                        break;
+                    case overlayEvent::PIXEL:
+                        overlayPixel(sink, i, ev.j, ev.k, x_mod, y_mod,
+                                     this_map, this_age, oceanic_collisions);
+                        break;
                     }
                 }
 
-                resolveJuxtapositions(i, j, k, x_mod, y_mod,
-                                      this_map, this_age, continental_collisions);
+                events.clear();
             }
+    }
+}
+
+void lithosphere::overlayBand(uint32_t band, uint32_t row_begin, uint32_t row_end,
+                              uint32_t& oceanic_collisions)
+{
+    const uint32_t world_width = _worldDimension.getWidth();
+    vector<uint32_t>& found = overlay_found[band];
+    found.assign(num_plates, 0);
+    bandOverlay sink(*this, found);
+    vector<uint32_t> spans;
+
+    const uint32_t band_first = row_begin * world_width;
+    const uint32_t band_size = (row_end - row_begin) * world_width;
+    memset(&hmap[band_first], 0, band_size * sizeof(float));
+    memset(&overlay_deferred[band_first], 0, band_size);
+    memset(&coverage[row_begin * coverage_words], 0,
+           (row_end - row_begin) * coverage_words * sizeof(uint64_t));
+
+    for (uint32_t i = 0; i < num_plates; ++i)
+    {
+        const Platec::WrappedRect rect(_worldDimension,
+                                       plates[i]->getLeftAsUint(),
+                                       plates[i]->getTopAsUint(),
+                                       plates[i]->getWidth(),
+                                       plates[i]->getHeight());
+
+        // Rows past the bottom edge of the world wrap around to the top,
+        // forming the second part of the plate.
+        for (uint32_t part = 0; part < rect.rowSpans(); ++part)
+        {
+            const Platec::WrappedSpan& rows = rect.rowSpan(part);
+            const uint32_t first = max(rows.world, row_begin);
+            const uint32_t last = min(rows.world + rows.length, row_end);
+
+            sink.events = &overlay_events[(band * num_plates + i) * 2 + part];
+
+            for (uint32_t y_mod = first; y_mod < last; ++y_mod)
+                overlayRow(sink, i, rect, rows.plate + y_mod - rows.world,
+                           y_mod, spans, oceanic_collisions);
         }
     }
 }
 
 void lithosphere::updateCollisions()
 {
+    aggregated.assign(num_plates, 0);
     for (uint32_t i = 0; i < num_plates; ++i)
     {
         for (uint32_t j = 0; j < collisions[i].size(); ++j)
@@ -576,6 +1037,7 @@ void lithosphere::updateCollisions()
                 float amount = plates[i]->aggregateCrust(
                                    plates[coll.index],
                                    coll.wx, coll.wy);
+                aggregated[i] |= amount > 0;
 
                 // Calculate new direction and speed for the
                 // merged plate system, that is, for the
@@ -587,6 +1049,51 @@ void lithosphere::updateCollisions()
 
         collisions[i].clear();
     }
+
+    // Plates that gave all of their crust away release their storage now,
+    // all the collisions are done with their old bounds. This does not
+    // wait for compaction to be asked for: the plate may get new crust at
+    // the divergent boundaries it left and live on, keeping its old maps.
+    for (uint32_t i = 0; i < num_plates; ++i)
+        if (plates[i]->isEmpty())
+            plates[i]->compact(compaction_ratio);
+
+    if (world_erosion &&
+            find(aggregated.begin(), aggregated.end(), 1) != aggregated.end())
+        reassignAggregatedCrust();
+}
+
+// Aggregation hands continents over to other plates behind the index map's
+// back, which names the giving plate until the next overlay. World erosion
+// reaches the crust through the index map, so the points a giving plate no
+// longer has crust at go to the plate that has most crust there. Plates
+// eroding on their own don't need this, and the map is left as it was.
+void lithosphere::reassignAggregatedCrust()
+{
+    const uint32_t width = _worldDimension.getWidth();
+    const uint32_t height = _worldDimension.getHeight();
+    const uint32_t threads = Platec::threadCount(num_threads);
+
+    #pragma omp parallel for schedule(static) num_threads(threads)
+    for (int y = 0; y < (int)height; ++y)
+        for (uint32_t x = 0; x < width; ++x)
+        {
+            const uint32_t k = y * width + x;
+            const uint32_t owner = imap[k];
+            if (owner >= num_plates || !aggregated[owner] ||
+                    plates[owner]->getCrust(x, y) > 0)
+                continue;
+
+            float most = 0;
+            for (uint32_t i = 0; i < num_plates; ++i)
+            {
+                const float crust = plates[i]->getCrust(x, y);
+                if (crust > most) {
+                    most = crust;
+                    imap[k] = i;
+                }
+            }
+        }
 }
 
 // Remove empty plates from the system.
@@ -615,6 +1122,354 @@ void lithosphere::removeEmptyPlates()
     }
 }
 
+// Realize accumulated external forces to each plate.
+// Every plate only touches its own data here, so the plates are handed out
+// to the worker threads one by one, the largest ones first: a huge plate
+// starts early and the small ones fill the gaps left on the other cores.
+// A plate bigger than a thread's share of all plates would still keep the
+// others waiting, so such plates erode first, one at a time on all threads.
+void lithosphere::movePlates(bool erode)
+{
+    const int threads = (int)Platec::threadCount(num_threads);
+
+    plate_order.resize(num_plates);
+    uint64_t total_area = 0;
+    for (uint32_t i = 0; i < num_plates; ++i) {
+        plate_order[i] = i;
+        total_area += plates[i]->getWidth() * plates[i]->getHeight();
+    }
+    sort(plate_order.begin(), plate_order.end(), LargerPlateFirst(plates));
+
+    uint32_t num_large = 0;
+    while (erode && threads > 1 && num_large < num_plates)
+    {
+        plate* p = plates[plate_order[num_large]];
+        if ((uint64_t)p->getWidth() * p->getHeight() * threads <= total_area)
+            break;
+
+        p->erode(CONTINENTAL_BASE, threads, erosion_model);
+        if (compaction_ratio > 0)
+            p->compact(compaction_ratio);
+        ++num_large;
+    }
+
+    Platec::ParallelError error;
+
+    #pragma omp parallel for schedule(dynamic, 1) num_threads(threads) if(threads > 1)
+    for (int n = 0; n < (int)num_plates; ++n)
+    {
+        try {
+            plate* p = plates[plate_order[n]];
+
+            if (erode && n >= (int)num_large) {
+                p->erode(CONTINENTAL_BASE, 1, erosion_model);
+                if (compaction_ratio > 0)
+                    p->compact(compaction_ratio);
+            }
+
+            p->move();
+
+            // Label the continents here, before the overlay needs them.
+            // They used to be found at their first collision instead, from
+            // crust the overlay had already changed for the plates stamped
+            // before, so a continent's extent depended on the order of the
+            // plates. Now every collision of the step sees the continents
+            // as they were when the plates moved, and the crust that turns
+            // continental during the overlay is labelled lazily as before.
+            p->resetSegments();
+        } catch (const exception& e) {
+            error.record(e.what());
+        }
+    }
+
+    error.rethrow();
+}
+
+// Erode the crust the plates show, as composed by the last overlay, in one
+// pass over the world. The steps are those of plate::erode: water, noise,
+// then the crust spreading to lower neighbours, in bands of rows. The
+// eroded heights go back to the plates owning each point.
+void lithosphere::erodeWorld()
+{
+    const uint32_t width = _worldDimension.getWidth();
+    const uint32_t height = _worldDimension.getHeight();
+    const uint32_t area = _worldDimension.getArea();
+    const uint32_t threads = Platec::threadCount(num_threads);
+    const uint32_t num_bands = min(height, threads);
+    Platec::ParallelError error;
+
+    if (world_crust.width() != width || world_crust.height() != height) {
+        HeightMap(width, height).swap(world_crust);
+        HeightMap(width, height).swap(world_eroded);
+        world_tiles.fill(width, height);
+    }
+    world_noise.resize(area);
+    world_stencils.resize(num_bands);
+
+    #pragma omp parallel for schedule(static) num_threads(threads)
+    for (int band = 0; band < (int)num_bands; ++band)
+    {
+        for (uint32_t y = band * height / num_bands;
+             y < (band + 1) * height / num_bands; ++y)
+            for (uint32_t x = 0; x < width; ++x) {
+                const uint32_t k = y * width + x;
+                world_crust[k] = imap[k] < num_plates ?
+                                 plates[imap[k]]->getCrust(x, y) : 0;
+            }
+    }
+
+    world_flow.compute(world_crust.raw_data(), width, height, true, true,
+                       CONTINENTAL_BASE, world_tiles);
+    world_flow.erode(world_crust.raw_data(), CONTINENTAL_BASE);
+
+    // Each band skips the values drawn for the rows before it.
+    #pragma omp parallel for schedule(static) num_threads(threads)
+    for (int band = 0; band < (int)num_bands; ++band)
+    {
+        const uint32_t first = band * height / num_bands * width;
+        const uint32_t last = (band + 1) * height / num_bands * width;
+        SimpleRandom random = _randsource;
+        random.jump(first);
+        random.fill_double(&world_noise[first], last - first);
+
+        for (uint32_t i = first; i < last; ++i) {
+            float alpha = 0.2 * (float)world_noise[i];
+            world_crust[i] += 0.1 * world_crust[i] - alpha * world_crust[i];
+        }
+    }
+    _randsource.jump(area);
+
+    #pragma omp parallel for schedule(static) num_threads(threads)
+    for (int band = 0; band < (int)num_bands; ++band)
+    {
+        world_stencils[band].erode(world_crust.raw_data(),
+                                   world_eroded.raw_data(), width, height,
+                                   true, true, CONTINENTAL_BASE, world_tiles,
+                                   band * height / num_bands,
+                                   (band + 1) * height / num_bands);
+    }
+
+    // Every point is set on one plate only, so bands can't collide. Sparse
+    // plates may have to allocate tiles for the eroded crust, which is not
+    // done concurrently.
+#ifdef PLATEC_SPARSE_PLATES
+    const bool set_in_bands = false;
+#else
+    const bool set_in_bands = true;
+#endif
+    #pragma omp parallel for schedule(static) num_threads(threads) if(set_in_bands)
+    for (int band = 0; band < (int)num_bands; ++band)
+    {
+        try {
+            for (uint32_t y = band * height / num_bands;
+                 y < (band + 1) * height / num_bands; ++y)
+                for (uint32_t x = 0; x < width; ++x) {
+                    const uint32_t k = y * width + x;
+                    if (imap[k] < num_plates)
+                        plates[imap[k]]->setErodedCrust(x, y, world_eroded[k]);
+                }
+        } catch (const exception& e) {
+            error.record(e.what());
+        }
+    }
+    error.rethrow();
+
+    #pragma omp parallel for schedule(dynamic, 1) num_threads(threads)
+    for (int i = 0; i < (int)num_plates; ++i)
+    {
+        try {
+            plates[i]->finishWorldErosion();
+            if (compaction_ratio > 0)
+                plates[i]->compact(compaction_ratio);
+        } catch (const exception& e) {
+            error.record(e.what());
+        }
+    }
+    error.rethrow();
+}
+
+// Buoyancy bonus of oceanic crust "h" of age "t" at iteration "now".
+static inline float buoyancy(float h, uint32_t t, uint32_t now)
+{
+    if (!(BUOYANCY_BONUS_X > 0))
+        return 0;
+
+    // Calculate the inverted age of this piece of crust.
+    // Force result to be minimum between inv. age and
+    // max buoyancy bonus age.
+    uint32_t crust_age = now - t;
+    crust_age = MAX_BUOYANCY_AGE - crust_age;
+    crust_age &= -(crust_age <= MAX_BUOYANCY_AGE);
+
+    return (h < CONTINENTAL_BASE) * BUOYANCY_BONUS_X *
+           OCEANIC_BASE * crust_age * MULINV_MAX_BUOYANCY_AGE;
+}
+
+// Add buoyancy to the young crust the plates have listed, which is all the
+// crust that gets any. Each plate only touches the locations it owns.
+//
+// @return Number of owned locations that were found without crust.
+uint32_t lithosphere::addYoungCrustBuoyancy(uint32_t threads)
+{
+    const uint32_t world_width = _worldDimension.getWidth();
+    const uint32_t world_height = _worldDimension.getHeight();
+    const uint32_t oldest = iter_count > MAX_BUOYANCY_AGE ?
+                            iter_count - MAX_BUOYANCY_AGE : 0;
+    uint32_t massless = 0;
+    young_found.resize(num_plates);
+
+    #pragma omp parallel for schedule(dynamic, 1) num_threads(threads) reduction(+:massless)
+    for (int i = 0; i < (int)num_plates; ++i)
+    {
+        const YoungCrust& young = plates[i]->getYoungCrust();
+        const uint32_t width = plates[i]->getWidth();
+        const uint32_t left = plates[i]->getLeftAsUint();
+        const uint32_t top = plates[i]->getTopAsUint();
+
+        // A location may be listed under several ages.
+        vector<uint32_t>& found = young_found[i];
+        found.clear();
+        for (uint32_t t = oldest; t <= iter_count; ++t)
+        {
+            const vector<uint32_t>& points = young.points(t);
+            for (uint32_t n = 0; n < points.size(); ++n)
+            {
+                uint32_t x = left + points[n] % width;
+                uint32_t y = top + points[n] / width;
+                x -= x < world_width ? 0 : world_width;
+                y -= y < world_height ? 0 : world_height;
+
+                // Points the overlay did not reach still name their
+                // previous owner.
+                const uint32_t k = y * world_width + x;
+                if (imap[k] == (PlateIndex)i && covered(x, y))
+                    found.push_back(k);
+            }
+        }
+
+        sort(found.begin(), found.end());
+        found.erase(unique(found.begin(), found.end()), found.end());
+        for (uint32_t n = 0; n < found.size(); ++n)
+        {
+            const uint32_t k = found[n];
+            massless += hmap[k] <= 0;
+            hmap[k] += buoyancy(hmap[k], amap[k], iter_count);
+        }
+
+        // The next iteration starts from one age later.
+        plates[i]->forgetCrustOlderThan(oldest + 1);
+    }
+
+    return massless;
+}
+
+// Fill divergent boundaries with new crustal material and add buoyancy to
+// young crust. The locations no plate reached are found in the coverage
+// bits left by the overlay, a word of 64 locations at a time. Rows are
+// split in bands, one per thread. New crust is handed over to the plates
+// afterwards, in the order of the world map.
+//
+// @param regenerate Also fill divergent boundaries, otherwise only add
+//                   buoyancy. Buoyancy then takes the whole world, since
+//                   there may be no plates to list the young crust.
+void lithosphere::updateWorldCrust(bool regenerate)
+{
+    const uint32_t world_width = _worldDimension.getWidth();
+    const uint32_t world_height = _worldDimension.getHeight();
+    const uint32_t threads = Platec::threadCount(num_threads);
+
+    if (!(regenerate && BOOL_REGENERATE_CRUST))
+    {
+        const int map_area = (int)_worldDimension.getArea();
+
+        #pragma omp parallel for schedule(static) num_threads(threads)
+        for (int i = 0; i < map_area; ++i)
+            hmap[i] += buoyancy(hmap[i], amap[i], iter_count);
+
+        return;
+    }
+
+#ifndef NDEBUG
+    // Only young crust is checked below in release builds. Every point the
+    // overlay reached must have crust, not just those.
+    for (uint32_t y = 0; y < world_height; ++y)
+        for (uint32_t w = 0; w < coverage_words; ++w)
+            for (uint64_t bits = coverage[y * coverage_words + w]; bits != 0;
+                    bits &= bits - 1)
+            {
+                const uint32_t k = y * world_width + w * 64 +
+                                   Platec::lowestBit(bits);
+                ASSERT(hmap[k] > 0, "Occupied point has no land mass!");
+            }
+#endif
+
+    if (addYoungCrustBuoyancy(threads) > 0) {
+        puts("Occupied point has no land mass!");
+        exit(1);
+    }
+
+    const uint32_t num_bands = min(world_height, threads);
+    const uint64_t last_word_mask = world_width % 64 == 0 ? ~(uint64_t)0 :
+                                    ((uint64_t)1 << (world_width % 64)) - 1;
+    band_gaps.resize(num_bands);
+
+    #pragma omp parallel for schedule(static) num_threads(threads)
+    for (int band = 0; band < (int)num_bands; ++band)
+    {
+        vector<uint32_t>& gaps = band_gaps[band];
+        gaps.clear();
+
+        const uint32_t first = band * world_height / num_bands;
+        const uint32_t last = (band + 1) * world_height / num_bands;
+
+        for (uint32_t y = first; y < last; ++y)
+        {
+            const uint64_t* row = &coverage[y * coverage_words];
+            for (uint32_t w = 0; w < coverage_words; ++w)
+            {
+                uint64_t bits = ~row[w];
+                if (w + 1 == coverage_words)
+                    bits &= last_word_mask;
+
+                for (; bits != 0; bits &= bits - 1)
+                {
+                    const uint32_t i = y * world_width + w * 64 +
+                                       Platec::lowestBit(bits);
+
+                    // The owner of this new crust is that neighbour plate
+                    // who was located at this point before plates moved:
+                    // the overlay leaves uncovered points of imap alone.
+
+                    // If this is oceanic crust then add buoyancy to it.
+                    // Magma that has just crystallized into oceanic crust
+                    // is more buoyant than that which has had a lot of
+                    // time to cool down and become more dense.
+                    amap[i] = iter_count;
+                    hmap[i] = OCEANIC_BASE * BUOYANCY_BONUS_X;
+                    hmap[i] += buoyancy(hmap[i], amap[i], iter_count);
+
+                    // This should probably not happen
+                    if (imap[i] < num_plates) {
+                        gaps.push_back(i);
+                    }
+                }
+            }
+        }
+    }
+
+    for (uint32_t band = 0; band < num_bands; ++band)
+    {
+        const vector<uint32_t>& gaps = band_gaps[band];
+        for (uint32_t g = 0; g < gaps.size(); ++g)
+        {
+            const uint32_t i = gaps[g];
+            plates[imap[i]]->setCrust(_worldDimension.xFromIndex(i),
+                                      _worldDimension.yFromIndex(i),
+                                      OCEANIC_BASE, iter_count);
+        }
+    }
+}
+
 void lithosphere::update()
 {
     try {
@@ -646,19 +1501,11 @@ void lithosphere::update()
         }
 
         const uint32_t map_area = _worldDimension.getArea();
-        // Keep a copy of the previous index map
-        prev_imap.copy(imap);
+        const bool erode = erosion_period > 0 && iter_count % erosion_period == 0;
+        if (erode && world_erosion)
+            erodeWorld();
 
-        // Realize accumulated external forces to each plate.
-        for (uint32_t i = 0; i < num_plates; ++i)
-        {
-            plates[i]->resetSegments();
-
-            if (erosion_period > 0 && iter_count % erosion_period == 0)
-                plates[i]->erode(CONTINENTAL_BASE);
-
-            plates[i]->move();
-        }
+        movePlates(erode && !world_erosion);
 
         uint32_t oceanic_collisions = 0;
         uint32_t continental_collisions = 0;
@@ -690,54 +1537,10 @@ void lithosphere::update()
 
         updateCollisions();
 
-        fill(plate_indices_found.begin(), plate_indices_found.end(), 0);
-
-        // Fill divergent boundaries with new crustal material, molten magma.
-        for (uint32_t y = 0, i = 0; y < BOOL_REGENERATE_CRUST * _worldDimension.getHeight(); ++y) {
-            for (uint32_t x = 0; x < _worldDimension.getWidth(); ++x, ++i) {
-                if (imap[i] >= num_plates) {
-                    // The owner of this new crust is that neighbour plate
-                    // who was located at this point before plates moved.
-                    imap[i] = prev_imap[i];
-
-                    // If this is oceanic crust then add buoyancy to it.
-                    // Magma that has just crystallized into oceanic crust
-                    // is more buoyant than that which has had a lot of
-                    // time to cool down and become more dense.
-                    amap[i] = iter_count;
-                    hmap[i] = OCEANIC_BASE * BUOYANCY_BONUS_X;
-
-                    // This should probably not happen
-                    if (imap[i] < num_plates) {
-                        plates[imap[i]]->setCrust(x, y, OCEANIC_BASE,
-                                                  iter_count);
-                    }
-
-                } else if (++plate_indices_found[imap[i]] && hmap[i] <= 0) {
-                    puts("Occupied point has no land mass!");
-                    exit(1);
-                }
-            }
-        }
+        updateWorldCrust(true);
 
         removeEmptyPlates();
 
-        //delete[] indexFound;
-
-        // Add some "virginity buoyancy" to all pixels for a visual boost! :)
-        for (uint32_t i = 0; i < (BUOYANCY_BONUS_X > 0) * map_area; ++i)
-        {
-            // Calculate the inverted age of this piece of crust.
-            // Force result to be minimum between inv. age and
-            // max buoyancy bonus age.
-            uint32_t crust_age = iter_count - amap[i];
-            crust_age = MAX_BUOYANCY_AGE - crust_age;
-            crust_age &= -(crust_age <= MAX_BUOYANCY_AGE);
-
-            hmap[i] += (hmap[i] < CONTINENTAL_BASE) * BUOYANCY_BONUS_X *
-                       OCEANIC_BASE * crust_age * MULINV_MAX_BUOYANCY_AGE;
-        }
-
         ++iter_count;
     } catch (const exception& e) {
         string msg = "Problem during update: ";
@@ -751,8 +1554,6 @@ void lithosphere::restart()
 {
     try {
 
-        const uint32_t map_area = _worldDimension.getArea();
-
         cycle_count += max_cycles > 0; // No increment if running for ever.
         if (cycle_count > max_cycles)
             return;
@@ -761,29 +1562,39 @@ void lithosphere::restart()
         hmap.set_all(0);
         for (uint32_t i = 0; i < num_plates; ++i)
         {
-            const uint32_t x0 = plates[i]->getLeftAsUint();
-            const uint32_t y0 = plates[i]->getTopAsUint();
-            const uint32_t x1 = x0 + plates[i]->getWidth();
-            const uint32_t y1 = y0 + plates[i]->getHeight();
-
-            const float*  this_map;
-            const uint32_t* this_age;
+            const uint32_t width = plates[i]->getWidth();
+            const Platec::WrappedRect rect(_worldDimension,
+                                           plates[i]->getLeftAsUint(),
+                                           plates[i]->getTopAsUint(),
+                                           width, plates[i]->getHeight());
+
+            CrustView this_map;
+            CrustAgeView this_age;
             plates[i]->getMap(&this_map, &this_age);
 
-            // Copy first part of plate onto world map.
-            for (uint32_t y = y0, j = 0; y < y1; ++y)
+            // Copy plate onto world map.
+            for (uint32_t v = 0; v < rect.rowSpans(); ++v)
             {
-                for (uint32_t x = x0; x < x1; ++x, ++j)
+                const Platec::WrappedSpan& rows = rect.rowSpan(v);
+                for (uint32_t r = 0; r < rows.length; ++r)
                 {
-                    const uint32_t x_mod = _worldDimension.xMod(x);
-                    const uint32_t y_mod = _worldDimension.yMod(y);
-                    const float h0 = hmap[_worldDimension.indexOf(x_mod, y_mod)];
-                    const float h1 = this_map[j];
-                    const uint32_t a0 = amap[_worldDimension.indexOf(x_mod, y_mod)];
-                    const uint32_t a1 =  this_age[j];
-
-                    amap[_worldDimension.indexOf(x_mod, y_mod)] = (h0 *a0 +h1 *a1) /(h0 +h1);
-                    hmap[_worldDimension.indexOf(x_mod, y_mod)] += this_map[j];
+                    for (uint32_t c = 0; c < rect.columnSpans(); ++c)
+                    {
+                        const Platec::WrappedSpan& cols = rect.columnSpan(c);
+                        const uint32_t j = (rows.plate + r) * width + cols.plate;
+                        const uint32_t k = _worldDimension.indexOf(cols.world, rows.world + r);
+
+                        for (uint32_t x = 0; x < cols.length; ++x)
+                        {
+                            const float h0 = hmap[k + x];
+                            const float h1 = this_map[j + x];
+                            const uint32_t a0 = amap[k + x];
+                            const uint32_t a1 =  this_age[j + x];
+
+                            amap[k + x] = (h0 *a0 +h1 *a1) /(h0 +h1);
+                            hmap[k + x] += this_map[j + x];
+                        }
+                    }
                 }
             }
         }
@@ -799,43 +1610,34 @@ void lithosphere::restart()
             // Restore the ages of plates' points of crust!
             for (uint32_t i = 0; i < num_plates; ++i)
             {
-                const uint32_t x0 = plates[i]->getLeftAsUint();
-                const uint32_t y0 = plates[i]->getTopAsUint();
-                const uint32_t x1 = x0 + plates[i]->getWidth();
-                const uint32_t y1 = y0 + plates[i]->getHeight();
+                const uint32_t width = plates[i]->getWidth();
+                const Platec::WrappedRect rect(_worldDimension,
+                                               plates[i]->getLeftAsUint(),
+                                               plates[i]->getTopAsUint(),
+                                               width, plates[i]->getHeight());
 
-                const float*  this_map;
-                const uint32_t* this_age_const;
-                uint32_t* this_age;
-
-                plates[i]->getMap(&this_map, &this_age_const);
-                this_age = (uint32_t *)this_age_const;
-
-                for (uint32_t y = y0, j = 0; y < y1; ++y)
+                for (uint32_t v = 0; v < rect.rowSpans(); ++v)
                 {
-                    for (uint32_t x = x0; x < x1; ++x, ++j)
-                    {
-                        const uint32_t x_mod = _worldDimension.xMod(x);
-                        const uint32_t y_mod = _worldDimension.yMod(y);
-
-                        this_age[j] = amap[_worldDimension.indexOf(x_mod, y_mod)];
-                    }
+                    const Platec::WrappedSpan& rows = rect.rowSpan(v);
+                    for (uint32_t r = 0; r < rows.length; ++r)
+                        for (uint32_t c = 0; c < rect.columnSpans(); ++c)
+                        {
+                            const Platec::WrappedSpan& cols = rect.columnSpan(c);
+                            plates[i]->restoreAges((rows.plate + r) * width + cols.plate,
+                                                   &amap[_worldDimension.indexOf(cols.world, rows.world + r)],
+                                                   cols.length);
+                        }
                 }
+
+                // Ages of the last cycle may lie ahead of this one's.
+                plates[i]->listYoungCrust(iter_count - MAX_BUOYANCY_AGE);
             }
 
             return;
         }
 
         // Add some "virginity buoyancy" to all pixels for a visual boost.
-        for (uint32_t i = 0; i < (BUOYANCY_BONUS_X > 0) * map_area; ++i)
-        {
-            uint32_t crust_age = iter_count - amap[i];
-            crust_age = MAX_BUOYANCY_AGE - crust_age;
-            crust_age &= -(crust_age <= MAX_BUOYANCY_AGE);
-
-            hmap[i] += (hmap[i] < CONTINENTAL_BASE) * BUOYANCY_BONUS_X *
-                       OCEANIC_BASE * crust_age * MULINV_MAX_BUOYANCY_AGE;
-        }
+        updateWorldCrust(false);
     } catch (const exception& e) {
         std::string msg = "Problem during restart: ";
         msg = msg + e.what();
@@ -855,7 +1657,7 @@ uint32_t lithosphere::getHeight() const
 
 uint32_t* lithosphere::getPlatesMap() const throw()
 {
-    return imap.raw_data();
+    return widenedMap(imap, imap_view);
 }
 
 const plate* lithosphere::getPlate(uint32_t index) const
@@ -28,6 +28,11 @@
 #endif
 #include <cmath>
 #include "heightmap.hpp"
+#include "plate_storage.hpp"
+#include "flow_accumulation.hpp"
+#include "erosion_stencil.hpp"
+#include "tile_occupancy.hpp"
+#include "world_storage.hpp"
 #include "rectangle.hpp"
 #include "simplerandom.hpp"
 
@@ -79,6 +84,7 @@ public:
      * @param aggr_ratio_abs # of overlapping points causing aggregation.
      * @param aggr_ratio_rel % of overlapping area causing aggregation.
      * @param num_cycles Number of times system will be restarted.
+     * @param _num_threads # of worker threads, 0 uses all available cores.
      * @exception	invalid_argument Exception is thrown if map side length
      *           	is not a power of two and greater than three.
      */
@@ -87,7 +93,8 @@ public:
                 float sea_level,
                 uint32_t _erosion_period, float _folding_ratio,
                 uint32_t aggr_ratio_abs, float aggr_ratio_rel,
-                uint32_t num_cycles, uint32_t _max_plates) throw(std::invalid_argument);
+                uint32_t num_cycles, uint32_t _max_plates,
+                uint32_t _num_threads = 1) throw(std::invalid_argument);
 
     ~lithosphere() throw(); ///< Standard destructor.
 
@@ -110,9 +117,47 @@ public:
         return _worldDimension;
     }
     uint32_t getPlateCount() const throw(); ///< Return number of plates.
+    uint32_t getThreadCount() const throw() {
+        return num_threads;
+    }
+    /// Set the number of worker threads, 0 uses all available cores.
+    void setThreadCount(uint32_t _num_threads) throw() {
+        num_threads = _num_threads;
+    }
+    float getCompactionRatio() const throw() {
+        return compaction_ratio;
+    }
+    /// Shrink plates whose crust covers less than this part of their
+    /// bounds, 0 (the default) keeps the bounds as they grew. Plates are
+    /// compacted after erosion; plates that lose all of their crust give
+    /// their storage back right away, whatever the ratio.
+    void setCompactionRatio(float ratio) throw() {
+        compaction_ratio = ratio;
+    }
+    ErosionModel getErosionModel() const throw() {
+        return erosion_model;
+    }
+    /// Choose how plates erode, RIVER_EROSION by default. Changes the
+    /// outcome of the simulation.
+    void setErosionModel(ErosionModel model) throw() {
+        erosion_model = model;
+    }
+    bool getWorldErosion() const throw() {
+        return world_erosion;
+    }
+    /// Erode the world as the plates compose it, in one pass over the
+    /// world's map, instead of each plate's bounds on its own. Water then
+    /// flows across plate borders, by flow accumulation whatever the
+    /// erosion model, and crust hidden under other plates doesn't erode.
+    /// Off by default. Changes the outcome of the simulation.
+    void setWorldErosion(bool enabled) throw() {
+        world_erosion = enabled;
+    }
     const uint32_t* getAgemap() const throw(); ///< Return surface age map.
     float* getTopography() const throw(); ///< Return height map.
-    uint32_t* getPlatesMap() const throw(); ///< Return a map of the plates owning eaach point
+    /// Return a map of the plates owning eaach point. The pointer is valid
+    /// until the next update, which swaps the index map buffers.
+    uint32_t* getPlatesMap() const throw();
     void update(); ///< Simulate one step of plate tectonics.
     uint32_t getWidth() const;
     uint32_t getHeight() const;
@@ -127,13 +172,22 @@ private:
     void updateHeightAndPlateIndexMaps(const uint32_t& map_area,
                                        uint32_t& oceanic_collisions,
                                        uint32_t& continental_collisions);
+    void overlayInBands(uint32_t threads, uint32_t& oceanic_collisions,
+                        uint32_t& continental_collisions);
+    void overlayBand(uint32_t band, uint32_t row_begin, uint32_t row_end,
+                     uint32_t& oceanic_collisions);
     void updateCollisions();
+    void reassignAggregatedCrust();
     void clearPlates();
     void growPlates();
     void removeEmptyPlates();
+    void updateWorldCrust(bool regenerate);
+    uint32_t addYoungCrustBuoyancy(uint32_t threads);
+    void movePlates(bool erode);
+    void erodeWorld();
     void resolveJuxtapositions(const uint32_t& i, const uint32_t& j, const uint32_t& k,
                                const uint32_t& x_mod, const uint32_t& y_mod,
-                               const float*& this_map, const uint32_t*& this_age, uint32_t& continental_collisions);
+                               CrustView& this_map, CrustAgeView& this_age, uint32_t& continental_collisions);
 
     /**
      * Container for collision details between two plates.
@@ -162,16 +216,79 @@ private:
         float crust; ///< Amount of crust that will deform/subduct.
     };
 
+    /**
+     * Order dependent side effect of the world overlay.
+     *
+     * When the overlay runs on many threads, these are recorded and then
+     * applied in the same order the single threaded overlay produces them.
+     */
+    class overlayEvent
+    {
+    public:
+        enum Kind {
+            MASS,          ///< Plate's crust at "j" changed from "a" to "b",
+                           ///< and so did its age if "k" is set.
+            SUBDUCTION,    ///< Plate "j" subducts "a" crust under plate at "k".
+            JUXTAPOSITION, ///< Continental collision of plate at "j", "k".
+            PIXEL          ///< Plate's pixel "j" lands on deferred location "k".
+        };
+        overlayEvent(Kind _kind, uint32_t _plate, uint32_t _j, uint32_t _k,
+                     float _a, float _b)
+        throw() : kind(_kind), plate(_plate), j(_j), k(_k), a(_a), b(_b) {}
+        Kind kind;
+        uint32_t plate; ///< Index of the plate the event applies to.
+        uint32_t j; ///< Index within plate's map or index of the other plate.
+        uint32_t k; ///< Index within the world map.
+        float a, b;
+    };
+
+    class directOverlay;
+    class bandOverlay;
+
+    void findOverlaps();
+    void findConflictSpans(uint32_t i, uint32_t row, vector<uint32_t>& spans) const;
+    /// Mark world location (x, y) as reached by the overlay.
+    void cover(uint32_t x, uint32_t y) {
+        coverage[y * coverage_words + (x >> 6)] |= (uint64_t)1 << (x & 63);
+    }
+    /// True if the overlay has already reached world location (x, y).
+    bool covered(uint32_t x, uint32_t y) const {
+        return (coverage[y * coverage_words + (x >> 6)] >> (x & 63)) & 1;
+    }
+    uint32_t copySpan(uint32_t i, uint32_t j, uint32_t k, uint32_t n,
+                      const CrustView& this_map, const CrustAgeView& this_age);
+
+    template <class Sink>
+    void overlayRow(Sink& sink, uint32_t i, const Platec::WrappedRect& rect,
+                    uint32_t row, uint32_t y_mod, vector<uint32_t>& spans,
+                    uint32_t& oceanic_collisions);
+
+    template <class Sink>
+    void overlayPixel(Sink& sink, uint32_t i, uint32_t j, uint32_t k,
+                      uint32_t x_mod, uint32_t y_mod,
+                      CrustView& this_map, CrustAgeView& this_age,
+                      uint32_t& oceanic_collisions);
+
     void restart(); //< Replace plates with a new population.
     WorldPoint randomPosition();
 
     HeightMap hmap; ///< Height map representing the topography of system.
-    IndexMap imap; ///< Plate index map of the "owner" of each map point.
-    IndexMap prev_imap; ///< Plate index map from the last update
-    AgeMap amap; ///< Age map of the system's surface (topography).
+    /// Plate index map of the "owner" of each map point. The overlay only
+    /// writes the points it covers, the others keep their previous owner.
+    PlateIndexMap imap;
+    /// Index of each world point on the map of the plate that owns it.
+    /// Kept by the overlay next to imap so that collisions can reach the
+    /// owner's crust directly. Points filled in afterwards are not tracked.
+    IndexMap lmap;
+    WorldAgeMap amap; ///< Age map of the system's surface (topography).
+    mutable IndexMap imap_view; ///< imap widened by getPlatesMap, if needed.
+    mutable AgeMap amap_view; ///< amap widened by getAgemap, if needed.
     plate** plates; ///< Array of plates that constitute the system.
     vector<plateArea> plate_areas;
-    vector<uint32_t> plate_indices_found; ///< Used in update loop to remove plates
+    vector<uint32_t> plate_indices_found; ///< Locations each plate got in the overlay.
+    vector<vector<uint32_t> > overlay_found; ///< Per band plate_indices_found.
+    vector<vector<uint32_t> > band_gaps; ///< Per band locations of new crust.
+    vector<vector<uint32_t> > young_found; ///< Per plate locations of young crust.
 
     uint32_t aggr_overlap_abs; ///< # of overlapping pixels -> aggregation.
     float  aggr_overlap_rel; ///< % of overlapping area -> aggregation.
@@ -182,9 +299,28 @@ private:
     uint32_t max_cycles; ///< Max n:o of times the system'll be restarted.
     uint32_t max_plates; ///< Number of plates in the initial setting.
     uint32_t num_plates; ///< Number of plates in the current setting.
+    uint32_t num_threads; ///< # of worker threads, 0 = all cores.
+    float compaction_ratio; ///< Occupancy below which plates shrink, 0 = never.
+    ErosionModel erosion_model; ///< How plates erode.
+    bool world_erosion; ///< Erode the composed world instead of each plate.
+    vector<uint32_t> plate_order; ///< Plates sorted by bounding box area.
 
     vector<vector<plateCollision> > collisions;
     vector<vector<plateCollision> > subductions;
+    vector<unsigned char> aggregated; ///< Plates that gave a continent away.
+    vector<vector<overlayEvent> > overlay_events; ///< Per band, plate and part.
+    vector<unsigned char> overlay_deferred; ///< Locations left to the replay.
+    /// One bit per world location some plate reached in the overlay. Each
+    /// row starts on a new word, so bands of rows never share one.
+    vector<uint64_t> coverage;
+    uint32_t coverage_words; ///< Words of coverage per row of the world.
+    vector<vector<uint32_t> > overlap_rects; ///< Per plate, areas shared with lower indexed plates.
+    HeightMap world_crust; ///< Visible crust of the world, being eroded.
+    HeightMap world_eroded; ///< World crust after erosion.
+    vector<double> world_noise; ///< Random values of erosion noise.
+    FlowAccumulation world_flow; ///< Drainage of the world.
+    vector<ErosionStencil> world_stencils; ///< One per band of rows.
+    TileOccupancy world_tiles; ///< All of the world, for the stencils.
 
     float peak_Ek; ///< Max total kinetic energy in the system so far.
     uint32_t last_coll_count; ///< Iterations since last cont. collision.
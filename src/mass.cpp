@@ -83,6 +83,12 @@ void Mass::incMass(float delta)
     }
 }
 
+void Mass::rebase(float dx, float dy)
+{
+    cx -= dx;
+    cy -= dy;
+}
+
 float Mass::getMass() const
 {
     return mass;
@@ -57,6 +57,9 @@ class Mass : public IMass
 public:
     Mass(float mass_, float cx_, float cy_);
     void incMass(float delta);
+    /// Express the center of mass relative to (dx, dy) of the old origin,
+    /// e.g. after the plate was cropped.
+    void rebase(float dx, float dy);
     float getMass() const;
     float getCx() const;
     float getCy() const;
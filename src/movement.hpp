@@ -33,8 +33,6 @@
 #define INITIAL_SPEED_X 1
 #define DEFORMATION_WEIGHT 2
 
-typedef uint32_t ContinentId;
-
 class IPlate;
 class plate;
 class IMass;
@@ -0,0 +1,104 @@
+/******************************************************************************
+ *  plate-tectonics, a plate tectonics simulation library
+ *  Copyright (C) 2012-2013 Lauri Viitanen
+ *  Copyright (C) 2014-2015 Federico Tomassetti, Bret Curtis
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, see http://www.gnu.org/licenses/
+ *****************************************************************************/
+
+#include "parallel.hpp"
+#include <stdexcept>
+
+namespace Platec {
+
+uint32_t threadCount(uint32_t requested)
+{
+#ifdef _OPENMP
+    if (requested == 0) {
+        return (uint32_t)omp_get_max_threads();
+    }
+    return requested;
+#else
+    (void)requested;
+    return 1;
+#endif
+}
+
+void ParallelError::record(const std::string& message)
+{
+    #pragma omp critical(platec_parallel_error)
+    {
+        if (!_failed) {
+            _failed = true;
+            _message = message;
+        }
+    }
+}
+
+void ParallelError::rethrow() const
+{
+    if (_failed) {
+        throw std::runtime_error(_message.c_str());
+    }
+}
+
+#if _WIN32 || _WIN64
+
+Mutex::Mutex()
+{
+    InitializeCriticalSection(&_section);
+}
+
+Mutex::~Mutex()
+{
+    DeleteCriticalSection(&_section);
+}
+
+void Mutex::lock()
+{
+    EnterCriticalSection(&_section);
+}
+
+void Mutex::unlock()
+{
+    LeaveCriticalSection(&_section);
+}
+
+#else
+
+Mutex::Mutex()
+{
+    if (pthread_mutex_init(&_mutex, NULL) != 0) {
+        throw std::runtime_error("Could not create mutex");
+    }
+}
+
+Mutex::~Mutex()
+{
+    pthread_mutex_destroy(&_mutex);
+}
+
+void Mutex::lock()
+{
+    pthread_mutex_lock(&_mutex);
+}
+
+void Mutex::unlock()
+{
+    pthread_mutex_unlock(&_mutex);
+}
+
+#endif
+
+}
@@ -0,0 +1,107 @@
+/******************************************************************************
+ *  plate-tectonics, a plate tectonics simulation library
+ *  Copyright (C) 2012-2013 Lauri Viitanen
+ *  Copyright (C) 2014-2015 Federico Tomassetti, Bret Curtis
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, see http://www.gnu.org/licenses/
+ *****************************************************************************/
+
+#ifndef PARALLEL_HPP
+#define PARALLEL_HPP
+
+#include <string>
+#include "utils.hpp"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#if !(_WIN32 || _WIN64)
+#include <pthread.h>
+#endif
+
+// Parallel sections of the simulation are written with OpenMP. When the
+// library is compiled without OpenMP support the pragmas are ignored and
+// everything runs on the calling thread, producing the very same results.
+
+namespace Platec {
+
+/// Translate a requested number of worker threads into the number that
+/// will actually be used.
+///
+/// @param  requested   Desired thread count, 0 means "all available cores".
+/// @return             Number of threads, always at least one.
+uint32_t threadCount(uint32_t requested);
+
+/// Collects the first error raised inside a parallel loop.
+///
+/// Exceptions must not escape an OpenMP region: loop bodies catch them,
+/// store the message here and the caller rethrows once the region is over.
+class ParallelError
+{
+public:
+    ParallelError() : _failed(false) {}
+
+    /// Remember the message of the first failure, ignore the others.
+    void record(const std::string& message);
+
+    /// Throw a runtime_error if any failure was recorded.
+    void rethrow() const;
+
+private:
+    bool _failed;
+    std::string _message;
+};
+
+/// Mutual exclusion between any threads, whether started by OpenMP or not.
+class Mutex
+{
+public:
+    Mutex();
+    ~Mutex();
+    void lock();
+    void unlock();
+
+private:
+    Mutex(const Mutex&);
+    Mutex& operator=(const Mutex&);
+
+#if _WIN32 || _WIN64
+    CRITICAL_SECTION _section;
+#else
+    pthread_mutex_t _mutex;
+#endif
+};
+
+/// Keeps a mutex locked for as long as the guard lives.
+class MutexLock
+{
+public:
+    explicit MutexLock(Mutex& mutex) : _mutex(mutex) {
+        _mutex.lock();
+    }
+    ~MutexLock() {
+        _mutex.unlock();
+    }
+
+private:
+    MutexLock(const MutexLock&);
+    MutexLock& operator=(const MutexLock&);
+
+    Mutex& _mutex;
+};
+
+}
+
+#endif
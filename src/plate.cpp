@@ -22,6 +22,7 @@
 #ifdef __MINGW32__ // this is to avoid a problem with the hypot function which is messed up by Python...
 #undef __STRICT_ANSI__
 #endif
+#include <algorithm> // min, max
 #include <cmath>     // sin, cos
 #include <cstdlib>   // rand
 #include <vector>
@@ -33,21 +34,65 @@
 #include "rectangle.hpp"
 #include "utils.hpp"
 #include "plate_functions.hpp"
+#include "parallel.hpp"
 
 using namespace std;
 
+// The helpers below take the plate's own Segments, whose calls are then
+// dispatched statically, or segments injected through ISegments.
+
+/// Count a collision on continent id and return the continent's area.
+template <class S>
+static uint32_t countCollision(S& segments, ContinentId id)
+{
+    segments[id].incCollCount();
+    return segments[id].area();
+}
+
+/// Hand the point at index, at (x, y) on the plate, to continent id.
+template <class S>
+static void addToContinent(S& segments, uint32_t index, uint32_t x, uint32_t y,
+                           ContinentId id)
+{
+    segments.setId(index, id);
+    segments[id].incArea();
+    segments[id].enlarge_to_contain(x, y);
+}
+
 plate::plate(long seed, float* m, uint32_t w, uint32_t h, uint32_t _x, uint32_t _y,
              uint32_t plate_age, WorldDimension worldDimension) :
     _randsource(seed),
     _mass(MassBuilder(m, Dimension(w, h)).build()),
-    map(m, w, h),
+    map(1, 1),
     age_map(w, h),
     _worldDimension(worldDimension),
-    _movement(_randsource, worldDimension)
+    _movement(_randsource, worldDimension),
+    _segmentLabeller(worldDimension)
+{
+    adoptCrust(map, m, w, h);
+    init(_x, _y, plate_age);
+}
+
+plate::plate(long seed, HeightMap& m, uint32_t _x, uint32_t _y,
+             uint32_t plate_age, WorldDimension worldDimension) :
+    _randsource(seed),
+    _mass(MassBuilder(m.raw_data(), Dimension(m.width(), m.height())).build()),
+    map(1, 1),
+    age_map(m.width(), m.height()),
+    _worldDimension(worldDimension),
+    _movement(_randsource, worldDimension),
+    _segmentLabeller(worldDimension)
+{
+    adoptCrust(map, m);
+    init(_x, _y, plate_age);
+}
+
+void plate::init(uint32_t _x, uint32_t _y, uint32_t plate_age)
 {
-    const uint32_t plate_area = w * h;
+    const uint32_t w = map.width(), h = map.height();
 
-    _bounds = new Bounds(worldDimension, FloatPoint(_x, _y), Dimension(w, h));
+    Bounds* bounds = new Bounds(_worldDimension, FloatPoint(_x, _y), Dimension(w, h));
+    _bounds = _myBounds = bounds;
 
     uint32_t k;
     for (uint32_t y = k = 0; y < _bounds->height(); ++y) {
@@ -57,12 +102,17 @@ plate::plate(long seed, float* m, uint32_t w, uint32_t h, uint32_t _x, uint32_t
             // the generation of new oceanic crust as if the plate
             // had been moving to its current direction until all
             // plate's (oceanic) crust receive an age.
-            age_map.set(x, y, plate_age & -(m[k] > 0));
+            age_map.set(x, y, narrowAge(plate_age & -(map[k] > 0)));
         }
     }
-    Segments* segments = new Segments(plate_area);
-    _segments = segments;
-    _mySegmentCreator = new MySegmentCreator(*_bounds, _segments, map, _worldDimension);
+    reserveAges(age_map, map);
+    _tiles.build(map);
+    _young.build(age_map, plate_age);
+
+    Segments* segments = new Segments(w, h);
+    _segments = _mySegments = segments;
+    _mySegmentCreator = new MySegmentCreator(*bounds, segments, map, _worldDimension,
+                                             _scratch);
     segments->setSegmentCreator(_mySegmentCreator);
     segments->setBounds(_bounds);
 }
@@ -76,9 +126,17 @@ plate::~plate()
 
 uint32_t plate::addCollision(uint32_t wx, uint32_t wy)
 {
-    ISegmentData& seg = getContinentAt(wx, wy);
-    seg.incCollCount();
-    return seg.area();
+    return _mySegments ? countCollision(*_mySegments, _mySegments->getContinentAt(wx, wy))
+                       : countCollision(*_segments, _segments->getContinentAt(wx, wy));
+}
+
+uint32_t plate::addCollision(uint32_t index)
+{
+    ContinentId id = continentId(index);
+    if (id >= _segments->size())
+        id = createSegment(index % _bounds->width(), index / _bounds->width());
+
+    return _mySegments ? countCollision(*_mySegments, id) : countCollision(*_segments, id);
 }
 
 void plate::addCrustByCollision(uint32_t x, uint32_t y, float z, uint32_t time, ContinentId activeContinent)
@@ -86,12 +144,96 @@ void plate::addCrustByCollision(uint32_t x, uint32_t y, float z, uint32_t time,
     // Add crust. Extend plate if necessary.
     setCrust(x, y, getCrust(x, y) + z, time);
 
-    uint32_t index = _bounds->getValidMapIndex(&x, &y);
-    _segments->setId(index, activeContinent);
+    uint32_t index = validMapIndex(&x, &y);
+    _segmentLabeller.markChanged(continentId(index));
+    markDirty(index);
+
+    if (_mySegments)
+        addToContinent(*_mySegments, index, x, y, activeContinent);
+    else
+        addToContinent(*_segments, index, x, y, activeContinent);
+}
+
+void plate::addContinent(const plate& src, ContinentId seg_id,
+                         uint32_t off_x, uint32_t off_y,
+                         ContinentId activeContinent)
+{
+    ASSERT(&src != this, "Plate cannot aggregate its own continent");
+    const ISegmentData& seg = (*src._segments)[seg_id];
+    const uint32_t src_width = src._bounds->width();
+
+    // Grow the bounds the way setCrust would grow them location by
+    // location, but lay the maps out only once for the final bounds.
+    const uint32_t old_width  = _bounds->width();
+    const uint32_t old_height = _bounds->height();
+    uint32_t d_lft = 0, d_top = 0;
+    for (uint32_t y = seg.getTop(); y <= seg.getBottom(); ++y)
+    {
+        for (uint32_t x = seg.getLeft(); x <= seg.getRight(); ++x)
+        {
+            const uint32_t i = y * src_width + x;
+            if ((src.continentId(i) != seg_id) || !(src.map[i] > 0))
+                continue;
+
+            uint32_t px = off_x + x, py = off_y + y;
+            if (mapIndex(&px, &py) == BAD_INDEX)
+                growBounds(off_x + x, off_y + y, d_lft, d_top);
+        }
+    }
+
+    if (_bounds->width() != old_width || _bounds->height() != old_height)
+        growStorage(old_width, old_height, d_lft, d_top);
+
+    const uint32_t world_width = _worldDimension.getWidth();
+    const uint32_t world_height = _worldDimension.getHeight();
+    const uint32_t width = _bounds->width();
+    const uint32_t left = _bounds->leftAsUint();
+    const uint32_t top = _bounds->topAsUint();
+
+    // Bounding box and area of the moved locations, added to the active
+    // continent at the end.
+    uint32_t moved = 0;
+    uint32_t min_x = width, max_x = 0, min_y = _bounds->height(), max_y = 0;
+
+    for (uint32_t y = seg.getTop(); y <= seg.getBottom(); ++y)
+    {
+        const uint32_t ly = (off_y + y + world_height - top) % world_height;
+        uint32_t lx = (off_x + seg.getLeft() + world_width - left) % world_width;
+        for (uint32_t x = seg.getLeft(); x <= seg.getRight(); ++x)
+        {
+            const uint32_t i = y * src_width + x;
+            if ((src.continentId(i) == seg_id) && (src.map[i] > 0))
+            {
+                ASSERT(lx < width && ly < _bounds->height(),
+                       "Continent must fit the grown plate");
+                const uint32_t j = ly * width + lx;
+                const float old_crust = map[j];
+                const float z = old_crust + src.map[i];
+                writeCrust(j, z, src.age_map[i]);
+                updateMass(old_crust, map[j]);
+
+                _segmentLabeller.markChanged(continentId(j));
+                _segmentLabeller.markDirty(lx, ly);
+                setContinentId(j, activeContinent);
+
+                ++moved;
+                min_x = std::min(min_x, lx);
+                max_x = std::max(max_x, lx);
+                min_y = std::min(min_y, ly);
+                max_y = std::max(max_y, ly);
+            }
+
+            if (++lx == world_width)
+                lx = 0;
+        }
+    }
 
-    ISegmentData& data = (*_segments)[activeContinent];
-    data.incArea();
-    data.enlarge_to_contain(x, y);
+    if (moved > 0) {
+        ISegmentData& data = (*_segments)[activeContinent];
+        data.incArea(moved);
+        data.enlarge_to_contain(min_x, min_y);
+        data.enlarge_to_contain(max_x, max_y);
+    }
 }
 
 void plate::addCrustBySubduction(uint32_t x, uint32_t y, float z, uint32_t t,
@@ -111,7 +253,7 @@ void plate::addCrustBySubduction(uint32_t x, uint32_t y, float z, uint32_t t,
     //       Drawbacks:
     //           Additional logic required
     //           Might place crust on other continent on same plate!
-    uint32_t index = _bounds->getValidMapIndex(&x, &y);
+    uint32_t index = validMapIndex(&x, &y);
 
     // Take vector difference only between plates that move more or less
     // to same direction. This makes subduction direction behave better.
@@ -140,10 +282,13 @@ void plate::addCrustBySubduction(uint32_t x, uint32_t y, float z, uint32_t t,
         if (map[index] > 0)
         {
             t = (map[index] * age_map[index] + z * t) / (map[index] + z);
-            age_map[index] = t * (z > 0);
+            writeAge(index, t * (z > 0));
 
+            if (map[index] < CONT_BASE && map[index] + z >= CONT_BASE)
+                markDirty(index);
+
+            _mass.incMass(crustChange(map[index], z));
             map[index] += z;
-            _mass.incMass(z);
         }
     }
 }
@@ -151,9 +296,9 @@ void plate::addCrustBySubduction(uint32_t x, uint32_t y, float z, uint32_t t,
 float plate::aggregateCrust(plate* p, uint32_t wx, uint32_t wy)
 {
     uint32_t lx = wx, ly = wy;
-    const uint32_t index = _bounds->getValidMapIndex(&lx, &ly);
+    const uint32_t index = validMapIndex(&lx, &ly);
 
-    const ContinentId seg_id = _segments->id(index);
+    const ContinentId seg_id = continentId(index);
 
     // This check forces the caller to do things in proper order!
     //
@@ -189,16 +334,16 @@ float plate::aggregateCrust(plate* p, uint32_t wx, uint32_t wy)
     float old_mass = _mass.getMass();
 
     // Add all of the collided continent's crust to destination plate.
-    for (uint32_t y = (*_segments)[seg_id].getTop(); y <= (*_segments)[seg_id].getBottom(); ++y)
+    p->addContinent(*this, seg_id, wx - lx, wy - ly, activeContinent);
+
+    const ISegmentData& seg = (*_segments)[seg_id];
+    for (uint32_t y = seg.getTop(); y <= seg.getBottom(); ++y)
     {
-        for (uint32_t x = (*_segments)[seg_id].getLeft(); x <= (*_segments)[seg_id].getRight(); ++x)
+        for (uint32_t x = seg.getLeft(); x <= seg.getRight(); ++x)
         {
             const uint32_t i = y * _bounds->width() + x;
-            if ((_segments->id(i) == seg_id) && (map[i] > 0))
+            if ((continentId(i) == seg_id) && (map[i] > 0))
             {
-                p->addCrustByCollision(wx + x - lx, wy + y - ly,
-                                       map[i], age_map[i], activeContinent);
-
                 _mass.incMass(-1.0f * map[i]);
                 map[i] = 0.0f;
             }
@@ -206,6 +351,7 @@ float plate::aggregateCrust(plate* p, uint32_t wx, uint32_t wy)
     }
 
     (*_segments)[seg_id].markNonExistent(); // Mark segment as non-existent
+    _segmentLabeller.markChanged(seg_id);
     return old_mass - _mass.getMass();
 }
 
@@ -235,233 +381,310 @@ void plate::calculateCrust(uint32_t x, uint32_t y, uint32_t index,
                      _worldDimension, map, _bounds->width(), _bounds->height());
 }
 
-void plate::findRiverSources(float lower_bound, vector<uint32_t>* sources)
+void plate::findRiverSources(float lower_bound, uint32_t y0, uint32_t y1,
+                             vector<uint32_t>* sources)
 {
-    const uint32_t bounds_height = _bounds->height();
     const uint32_t bounds_width = _bounds->width();
 
-    // Find all tops.
-    for (uint32_t y = 0; y < bounds_height; ++y) {
+    // Find all tops. Empty tiles have none.
+    for (uint32_t y = y0; y < y1; ++y) {
         const uint32_t y_width = y * bounds_width;
-        for (uint32_t x = 0; x < bounds_width; ++x) {
-            const uint32_t index = y_width + x;
-
-            if (map[index] < lower_bound) {
-                continue;
+        for (uint32_t x0, x1 = 0; _tiles.nextRun(y, x1, bounds_width, x0, x1);) {
+            for (uint32_t x = x0; x < x1; ++x) {
+                const uint32_t index = y_width + x;
+
+                if (map[index] < lower_bound) {
+                    continue;
+                }
+
+                float w_crust, e_crust, n_crust, s_crust;
+                uint32_t w, e, n, s;
+                calculateCrust(x, y, index, w_crust, e_crust, n_crust, s_crust,
+                               w, e, n, s);
+
+                // This location is either at the edge of the plate or it is not the
+                // tallest of its neightbours. Don't start a river from here.
+                if (w_crust * e_crust * n_crust * s_crust == 0) {
+                    continue;
+                }
+
+                sources->push_back(index);
             }
-
-            float w_crust, e_crust, n_crust, s_crust;
-            uint32_t w, e, n, s;
-            calculateCrust(x, y, index, w_crust, e_crust, n_crust, s_crust,
-                           w, e, n, s);
-
-            // This location is either at the edge of the plate or it is not the
-            // tallest of its neightbours. Don't start a river from here.
-            if (w_crust * e_crust * n_crust * s_crust == 0) {
-                continue;
-            }
-
-            sources->push_back(index);
         }
     }
 }
 
-void plate::flowRivers(float lower_bound, vector<uint32_t>* sources, HeightMap& tmp)
+// Claim point "index" of the bitmap. Tells whether it was free.
+static inline bool claimPoint(uint64_t* bits, uint32_t index)
+{
+    const uint64_t bit = (uint64_t)1 << (index % 64);
+    uint64_t old;
+#if defined(_OPENMP) && _OPENMP >= 201107
+    #pragma omp atomic capture
+    { old = bits[index / 64]; bits[index / 64] |= bit; }
+#else
+    #pragma omp critical(flow_done)
+    { old = bits[index / 64]; bits[index / 64] |= bit; }
+#endif
+    return !(old & bit);
+}
+
+// Erode point "index" with the water flowing through it and pass the water
+// on to its lowest neighbour, unless a river has reached that one already.
+void plate::flowRiver(uint32_t index, float lower_bound, HeightMap& tmp,
+                      vector<uint32_t>& sinks)
 {
-    const uint32_t bounds_area = _bounds->area();
-    vector<uint32_t> sinks_data;
-    vector<uint32_t>* sinks = &sinks_data;
+    const uint32_t y = index / _bounds->width();
+    const uint32_t x = index - y * _bounds->width();
 
-    static vector<bool> s_flowDone;
-    if (s_flowDone.size() < bounds_area) {
-        s_flowDone.resize(bounds_area);
+    if (map[index] < lower_bound) {
+        return;
     }
-    fill(s_flowDone.begin(), s_flowDone.begin() + bounds_area, false);
 
-    // From each top, start flowing water along the steepest slope.
-    while (!sources->empty()) {
-        while (!sources->empty()) {
-            const uint32_t index = sources->back();
-            const uint32_t y = index / _bounds->width();
-            const uint32_t x = index - y * _bounds->width();
+    float w_crust, e_crust, n_crust, s_crust;
+    uint32_t w, e, n, s;
+    calculateCrust(x, y, index, w_crust, e_crust, n_crust, s_crust,
+                   w, e, n, s);
 
-            sources->pop_back();
+    // If this is the lowest part of its neighbourhood, stop.
+    if (w_crust + e_crust + n_crust + s_crust == 0) {
+        return;
+    }
 
-            if (map[index] < lower_bound) {
-                continue;
-            }
+    w_crust += (w_crust == 0) * map[index];
+    e_crust += (e_crust == 0) * map[index];
+    n_crust += (n_crust == 0) * map[index];
+    s_crust += (s_crust == 0) * map[index];
 
-            float w_crust, e_crust, n_crust, s_crust;
-            uint32_t w, e, n, s;
-            calculateCrust(x, y, index, w_crust, e_crust, n_crust, s_crust,
-                           w, e, n, s);
+    // Find lowest neighbour.
+    float lowest_crust = w_crust;
+    uint32_t dest = index - 1;
 
-            // If this is the lowest part of its neighbourhood, stop.
-            if (w_crust + e_crust + n_crust + s_crust == 0) {
-                continue;
-            }
+    if (e_crust < lowest_crust) {
+        lowest_crust = e_crust;
+        dest = index + 1;
+    }
 
-            w_crust += (w_crust == 0) * map[index];
-            e_crust += (e_crust == 0) * map[index];
-            n_crust += (n_crust == 0) * map[index];
-            s_crust += (s_crust == 0) * map[index];
+    if (n_crust < lowest_crust) {
+        lowest_crust = n_crust;
+        dest = index - _bounds->width();
+    }
 
-            // Find lowest neighbour.
-            float lowest_crust = w_crust;
-            uint32_t dest = index - 1;
+    if (s_crust < lowest_crust) {
+        lowest_crust = s_crust;
+        dest = index + _bounds->width();
+    }
 
-            if (e_crust < lowest_crust) {
-                lowest_crust = e_crust;
-                dest = index + 1;
-            }
+    // if it's not handled yet, add it as new sink.
+    if (dest < _bounds->area() && claimPoint(&_scratch.flowDone[0], dest)) {
+        sinks.push_back(dest);
+    }
 
-            if (n_crust < lowest_crust) {
-                lowest_crust = n_crust;
-                dest = index - _bounds->width();
-            }
+    // Erode this location with the water flow.
+    tmp[index] -= (tmp[index] - lower_bound) * 0.2;
+}
 
-            if (s_crust < lowest_crust) {
-                lowest_crust = s_crust;
-                dest = index + _bounds->width();
-            }
+// Rivers advance one step at a time from all of their points at once. The
+// points of a step are all different: the first ones are the tops, the
+// next ones are claimed in the bitmap of reached points, once. So threads
+// can share a step, each eroding its own points, and whichever thread
+// claims a point first passes the water on to it. Neither the erosion nor
+// the points reached depend on the threads.
+void plate::flowRivers(float lower_bound, vector<uint32_t>* sources,
+                       HeightMap& tmp, uint32_t threads)
+{
+    // Steps with fewer points are not worth waking the other threads for.
+    const uint32_t min_parallel_points = 1024;
 
-            // if it's not handled yet, add it as new sink.
-            if (dest < _bounds->area() && !s_flowDone[dest]) {
-                sinks->push_back(dest);
-                s_flowDone[dest] = true;
-            }
+    _scratch.flowDone.assign((_bounds->area() + 63) / 64, 0);
+    vector<vector<uint32_t> >& part_sinks = _scratch.bandSources;
+    Platec::ParallelError error;
 
-            // Erode this location with the water flow.
-            tmp[index] -= (tmp[index] - lower_bound) * 0.2;
+    // From each top, start flowing water along the steepest slope.
+    while (!sources->empty())
+    {
+        const uint32_t count = sources->size();
+        const uint32_t parts = count >= min_parallel_points ? max(1u, threads) : 1;
+        if (part_sinks.size() < parts)
+            part_sinks.resize(parts);
+
+        #pragma omp parallel for schedule(static) num_threads(parts) if(parts > 1)
+        for (int part = 0; part < (int)parts; ++part)
+        {
+            try {
+                // Like a single thread would, go from the end of the list.
+                const uint32_t first = count - (part + 1) * count / parts;
+                const uint32_t last = count - part * count / parts;
+                part_sinks[part].clear();
+                for (uint32_t i = last; i-- > first;)
+                    flowRiver((*sources)[i], lower_bound, tmp, part_sinks[part]);
+            } catch (const exception& e) {
+                error.record(e.what());
+            }
         }
+        error.rethrow();
 
+        sources->clear();
+        for (uint32_t part = 0; part < parts; ++part)
+            sources->insert(sources->end(), part_sinks[part].begin(),
+                            part_sinks[part].end());
+    }
+}
 
-        vector<uint32_t>* v_tmp = sources;
-        sources = sinks;
-        sinks = v_tmp;
-        sinks->clear();
+// Add random noise (10 %) to rows [y0, y1[ of the height map. Points of
+// empty tiles stay zero, the values they would draw are skipped over. The
+// generator is not advanced, "random" is a copy of it.
+void plate::addNoise(HeightMap& tmpHm, SimpleRandom random, uint32_t y0,
+                     uint32_t y1)
+{
+    const uint32_t width = _bounds->width();
+    vector<double>& noise = _scratch.noise;
+    uint32_t drawn = 0;
+    for (uint32_t y = y0; y < y1; ++y) {
+        for (uint32_t x0, x1 = 0; _tiles.nextRun(y, x1, width, x0, x1);) {
+            const uint32_t first = y * width + x0, last = y * width + x1;
+            if (first > drawn)
+                random.jump(first - drawn);
+            random.fill_double(&noise[first], last - first);
+            drawn = last;
+
+            for (uint32_t i = first; i < last; ++i) {
+                float alpha = 0.2 * (float)noise[i];
+                tmpHm[i] += 0.1 * tmpHm[i] - alpha * tmpHm[i];
+            }
+        }
     }
 }
 
-void plate::erode(float lower_bound)
+// Erode the points rivers flow through, starting from the tops.
+void plate::erodeByRivers(float lower_bound, HeightMap& tmpHm, uint32_t threads)
 {
-    vector<uint32_t> sources_data;
-    vector<uint32_t>* sources = &sources_data;
+    const uint32_t height = _bounds->height();
+    const uint32_t num_bands = max(1u, min(height, threads));
+    Platec::ParallelError error;
 
-    HeightMap tmpHm(map);
-    findRiverSources(lower_bound, sources);
-    flowRivers(lower_bound, sources, tmpHm);
+    vector<uint32_t>* sources = &_scratch.sources;
+    vector<vector<uint32_t> >& band_sources = _scratch.bandSources;
+    band_sources.resize(num_bands);
 
-    // Add random noise (10 %) to heightmap.
-    for (uint32_t i = 0; i < _bounds->area(); ++i) {
-        float alpha = 0.2 * (float)_randsource.next_double();
-        tmpHm[i] += 0.1 * tmpHm[i] - alpha * tmpHm[i];
+    #pragma omp parallel for schedule(static) num_threads(threads) if(num_bands > 1)
+    for (int band = 0; band < (int)num_bands; ++band)
+    {
+        try {
+            band_sources[band].clear();
+            findRiverSources(lower_bound, band * height / num_bands,
+                             (band + 1) * height / num_bands, &band_sources[band]);
+        } catch (const exception& e) {
+            error.record(e.what());
+        }
     }
+    error.rethrow();
 
-    map = tmpHm;
-    tmpHm.set_all(0.0f);
+    sources->clear();
+    for (uint32_t band = 0; band < num_bands; ++band)
+        sources->insert(sources->end(), band_sources[band].begin(),
+                        band_sources[band].end());
+    flowRivers(lower_bound, sources, tmpHm, threads);
+}
+
+// Erode every point of land in proportion to the water flowing through it.
+void plate::erodeByFlow(float lower_bound, HeightMap& tmpHm)
+{
+    FlowAccumulation& flow = _scratch.flow;
+    flow.compute(tmpHm.raw_data(), _bounds->width(), _bounds->height(),
+                 _bounds->width() == _worldDimension.getWidth(),
+                 _bounds->height() == _worldDimension.getHeight(),
+                 lower_bound, _tiles);
+    flow.erode(tmpHm.raw_data(), lower_bound);
+}
+
+// The plate is cut into bands of rows, one per thread. Every band adds its
+// noise and spreads its crust by itself, as the rivers find their sources;
+// the results are put together in the order a single band would give them.
+void plate::erode(float lower_bound, uint32_t threads, ErosionModel model)
+{
+    const uint32_t width = _bounds->width();
+    const uint32_t height = _bounds->height();
+    const uint32_t num_bands = max(1u, min(height, threads));
+
+    HeightMap& tmpHm = _scratch.erosion;
+    widenCrust(tmpHm, map);
+    _segmentLabeller.markAllDirty();
+
+    if (model == FLOW_ACCUMULATION_EROSION)
+        erodeByFlow(lower_bound, tmpHm);
+    else
+        erodeByRivers(lower_bound, tmpHm, threads);
+
+    // Each band skips the values drawn for the rows before it.
+    _scratch.noise.resize(_bounds->area());
+    #pragma omp parallel for schedule(static) num_threads(threads) if(num_bands > 1)
+    for (int band = 0; band < (int)num_bands; ++band)
+    {
+        addNoise(tmpHm, _randsource, band * height / num_bands,
+                 (band + 1) * height / num_bands);
+    }
+    _randsource.jump(_bounds->area());
+
+    narrowCrust(map, tmpHm);
     MassBuilder massBuilder;
 
-    for (uint32_t y = 0; y < _bounds->height(); ++y)
+    // Points of empty tiles are zero and give nothing away.
+    for (uint32_t y = 0; y < height; ++y)
+        for (uint32_t x0, x1 = 0; _tiles.nextRun(y, x1, width, x0, x1);)
+            for (uint32_t x = x0; x < x1; ++x)
+                massBuilder.addPoint(x, y, map[y * width + x]);
+
+    // Spread the crust of each point among its lower neighbours. Rows and
+    // columns wrap around when the plate spans the whole world.
+    const float* crust = crustValues(map, _scratch.crust);
+    vector<ErosionStencil>& stencils = _scratch.erosionStencils;
+    stencils.resize(num_bands);
+
+    #pragma omp parallel for schedule(static) num_threads(threads) if(num_bands > 1)
+    for (int band = 0; band < (int)num_bands; ++band)
     {
-        for (uint32_t x = 0; x < _bounds->width(); ++x)
-        {
-            const uint32_t index = y * _bounds->width() + x;
-            massBuilder.addPoint(x, y, map[index]);
-            tmpHm[index] += map[index]; // Careful not to overwrite earlier amounts.
+        stencils[band].erode(crust, tmpHm.raw_data(), width, height,
+                             width == _worldDimension.getWidth(),
+                             height == _worldDimension.getHeight(),
+                             lower_bound, _tiles, band * height / num_bands,
+                             (band + 1) * height / num_bands);
+    }
+    narrowCrust(map, tmpHm);
+    reserveAges(age_map, map);
+    _mass = massBuilder.build();
 
-            if (map[index] < lower_bound)
-                continue;
+    // Crust may have spread to the tiles next to the occupied ones.
+    _tiles.refresh(map);
 
-            float w_crust, e_crust, n_crust, s_crust;
-            uint32_t w, e, n, s;
-            calculateCrust(x, y, index, w_crust, e_crust, n_crust, s_crust,
-                           w, e, n, s);
+#ifdef PLATEC_SPARSE_PLATES
+    // The dense buffers span the bounding box, keep them only while eroding.
+    _scratch.releaseErosion();
+#endif
+}
 
-            // This location has no neighbours (ARTIFACT!) or it is the lowest
-            // part of its area. In either case the work here is done.
-            if (w_crust + e_crust + n_crust + s_crust == 0)
-                continue;
+void plate::setErodedCrust(uint32_t x, uint32_t y, float z)
+{
+    const uint32_t index = mapIndex(&x, &y);
+    ASSERT(index != BAD_INDEX, "Eroded location must be inside the plate");
+    if (index != BAD_INDEX)
+        map[index] = z;
+}
 
-            // The steeper the slope, the more water flows along it.
-            // The more downhill (sources), the more water flows to here.
-            // 1+1+10 = 12, avg = 4, stdev = sqrt((3*3+3*3+6*6)/3) = 4.2, var = 18,
-            //  1*1+1*1+10*10 = 102, 102/4.2=24
-            // 1+4+7 = 12, avg = 4, stdev = sqrt((3*3+0*0+3*3)/3) = 2.4, var = 6,
-            //  1*1+4*4+7*7 = 66, 66/2.4 = 27
-            // 4+4+4 = 12, avg = 4, stdev = sqrt((0*0+0*0+0*0)/3) = 0, var = 0,
-            //  4*4+4*4+4*4 = 48, 48/0 = inf -> 48
-            // If there's a source slope of height X then it will always cause
-            // water erosion of amount Y. Then again from one spot only so much
-            // water can flow.
-            // Thus, the calculated non-linear flow value for this location is
-            // multiplied by the "water erosion" constant.
-            // The result is max(result, 1.0). New height of this location could
-            // be e.g. h_lowest + (1 - 1 / result) * (h_0 - h_lowest).
-
-            // Calculate the difference in height between this point and its
-            // nbours that are lower than this point.
-            float w_diff = map[index] - w_crust;
-            float e_diff = map[index] - e_crust;
-            float n_diff = map[index] - n_crust;
-            float s_diff = map[index] - s_crust;
-
-            float min_diff = w_diff;
-            min_diff -= (min_diff - e_diff) * (e_diff < min_diff);
-            min_diff -= (min_diff - n_diff) * (n_diff < min_diff);
-            min_diff -= (min_diff - s_diff) * (s_diff < min_diff);
-
-            // Calculate the sum of difference between lower neighbours and
-            // the TALLEST lower neighbour.
-            float diff_sum = (w_diff - min_diff) * (w_crust > 0) +
-                             (e_diff - min_diff) * (e_crust > 0) +
-                             (n_diff - min_diff) * (n_crust > 0) +
-                             (s_diff - min_diff) * (s_crust > 0);
-
-            // Erosion difference sum is negative!
-            ASSERT(diff_sum >= 0, "Difference sum must be positive");
-
-            if (diff_sum < min_diff)
-            {
-                // There's NOT enough room in neighbours to contain all the
-                // crust from this peak so that it would be as tall as its
-                // tallest lower neighbour. Thus first step is make ALL
-                // lower neighbours and this point equally tall.
-                tmpHm[w] += (w_diff - min_diff) * (w_crust > 0);
-                tmpHm[e] += (e_diff - min_diff) * (e_crust > 0);
-                tmpHm[n] += (n_diff - min_diff) * (n_crust > 0);
-                tmpHm[s] += (s_diff - min_diff) * (s_crust > 0);
-                tmpHm[index] -= min_diff;
-
-                min_diff -= diff_sum;
-
-                // Spread the remaining crust equally among all lower nbours.
-                min_diff /= 1 + (w_crust > 0) + (e_crust > 0) +
-                            (n_crust > 0) + (s_crust > 0);
-
-                tmpHm[w] += min_diff * (w_crust > 0);
-                tmpHm[e] += min_diff * (e_crust > 0);
-                tmpHm[n] += min_diff * (n_crust > 0);
-                tmpHm[s] += min_diff * (s_crust > 0);
-                tmpHm[index] += min_diff;
-            }
-            else
-            {
-                float unit = min_diff / diff_sum;
+void plate::finishWorldErosion()
+{
+    const uint32_t width = _bounds->width();
+    _segmentLabeller.markAllDirty();
 
-                // Remove all crust from this location making it as tall as
-                // its tallest lower neighbour.
-                tmpHm[index] -= min_diff;
+    // Crust may have spread to the tiles next to the occupied ones.
+    _tiles.refresh(map);
+    reserveAges(age_map, map);
 
-                // Spread all removed crust among all other lower neighbours.
-                tmpHm[w] += unit * (w_diff - min_diff) * (w_crust > 0);
-                tmpHm[e] += unit * (e_diff - min_diff) * (e_crust > 0);
-                tmpHm[n] += unit * (n_diff - min_diff) * (n_crust > 0);
-                tmpHm[s] += unit * (s_diff - min_diff) * (s_crust > 0);
-            }
-        }
-    }
-    map = tmpHm;
+    MassBuilder massBuilder;
+    for (uint32_t y = 0; y < _bounds->height(); ++y)
+        for (uint32_t x0, x1 = 0; _tiles.nextRun(y, x1, width, x0, x1);)
+            for (uint32_t x = x0; x < x1; ++x)
+                massBuilder.addPoint(x, y, map[y * width + x]);
     _mass = massBuilder.build();
 }
 
@@ -476,30 +699,31 @@ void plate::getCollisionInfo(uint32_t wx, uint32_t wy, uint32_t* count, float* r
 
 uint32_t plate::getContinentArea(uint32_t wx, uint32_t wy) const
 {
-    const uint32_t index = _bounds->getValidMapIndex(&wx, &wy);
-    ASSERT(_segments->id(index) < _segments->size(), "Segment index invalid");
-    return (*_segments)[_segments->id(index)].area();
+    const uint32_t index = validMapIndex(&wx, &wy);
+    const ContinentId id = continentId(index);
+    ASSERT(id < _segments->size(), "Segment index invalid");
+    return _mySegments ? (*_mySegments)[id].area() : (*_segments)[id].area();
 }
 
 float plate::getCrust(uint32_t x, uint32_t y) const
 {
-    const uint32_t index = _bounds->getMapIndex(&x, &y);
-    return index != BAD_INDEX ? map[index] : 0;
+    const uint32_t index = mapIndex(&x, &y);
+    return index != BAD_INDEX ? (float)map[index] : 0;
 }
 
 uint32_t plate::getCrustTimestamp(uint32_t x, uint32_t y) const
 {
-    const uint32_t index = _bounds->getMapIndex(&x, &y);
+    const uint32_t index = mapIndex(&x, &y);
     return index != BAD_INDEX ? age_map[index] : 0;
 }
 
-void plate::getMap(const float** c, const uint32_t** t) const
+void plate::getMap(CrustView* c, CrustAgeView* t) const
 {
     if (c) {
-        *c = map.raw_data();
+        *c = mapView(map);
     }
     if (t) {
-        *t = age_map.raw_data();
+        *t = mapView(age_map);
     }
 }
 
@@ -513,10 +737,71 @@ void plate::move()
     _bounds->shift(_movement.velocityOnX(), _movement.velocityOnY());
 }
 
+bool plate::compact(float min_ratio)
+{
+    const uint32_t width = _bounds->width();
+    const uint32_t height = _bounds->height();
+
+    // Bounding box of the crust, empty tiles have none.
+    uint32_t lft = width, rgt = 0, top = height, btm = 0;
+    for (uint32_t y = 0; y < height; ++y) {
+        for (uint32_t x0, x1 = 0; _tiles.nextRun(y, x1, width, x0, x1);) {
+            for (uint32_t x = x0; x < x1; ++x) {
+                if (map[y * width + x] != 0) {
+                    lft = min(lft, x);
+                    rgt = max(rgt, x);
+                    top = min(top, y);
+                    btm = max(btm, y);
+                }
+            }
+        }
+    }
+
+    if (lft > rgt) {
+        lft = rgt = top = btm = 0; // No crust left.
+    } else if ((float)(rgt - lft + 1) * (btm - top + 1) >=
+               min_ratio * width * height) {
+        return false;
+    }
+
+    const uint32_t new_width = rgt - lft + 1;
+    const uint32_t new_height = btm - top + 1;
+    if (new_width == width && new_height == height)
+        return false;
+
+    map.crop(lft, top, new_width, new_height);
+    age_map.crop(lft, top, new_width, new_height);
+    _young.crop(width, lft, top, new_width, new_height);
+    _segments->crop(width, lft, top, new_width, new_height);
+    _segments->reset();
+    _segmentLabeller.markAllDirty();
+
+    _bounds->shift(lft, top);
+    _bounds->shrink(width - new_width, height - new_height);
+    _mass.rebase(lft, top);
+    reserveAges(age_map, map);
+    _tiles.build(map);
+    _scratch.release();
+
+    return true;
+}
+
+void plate::listYoungCrust(uint32_t oldest)
+{
+    _young.build(age_map, oldest);
+}
+
 void plate::resetSegments()
 {
+    ASSERT(_mySegments, "Continents are labelled on the plate's own segments");
     ASSERT(_bounds->area() == _segments->area(), "Segments doesn't have the expected area");
-    _segments->reset();
+    _segmentLabeller.update(map, _bounds->width(), _bounds->height(), *_mySegments,
+                            &_tiles);
+}
+
+void plate::markDirty(uint32_t index)
+{
+    _segmentLabeller.markDirty(index % _bounds->width(), index / _bounds->width());
 }
 
 void plate::setCrust(uint32_t x, uint32_t y, float z, uint32_t t)
@@ -527,94 +812,76 @@ void plate::setCrust(uint32_t x, uint32_t y, float z, uint32_t t)
 
     uint32_t _x = x;
     uint32_t _y = y;
-    uint32_t index = _bounds->getMapIndex(&_x, &_y);
+    uint32_t index = mapIndex(&_x, &_y);
 
     if (index == BAD_INDEX)
     {
         // Extending plate for nothing!
         ASSERT(z > 0, "Height value must be non-zero");
 
-        const uint32_t ilft = _bounds->leftAsUint();
-        const uint32_t itop = _bounds->topAsUint();
-        const uint32_t irgt = _bounds->rightAsUintNonInclusive();
-        const uint32_t ibtm = _bounds->bottomAsUintNonInclusive();
-
-        _worldDimension.normalize(x, y);
-
-        // Calculate distance of new point from plate edges.
-        const uint32_t _lft = ilft - x;
-        const uint32_t _rgt = (_worldDimension.getWidth() & -(x < ilft)) + x - irgt;
-        const uint32_t _top = itop - y;
-        const uint32_t _btm = (_worldDimension.getHeight() & -(y < itop)) + y - ibtm;
-
-        // Set larger of horizontal/vertical distance to zero.
-        // A valid distance is NEVER larger than world's side's length!
-        uint32_t d_lft = _lft & -(_lft <  _rgt) & -(_lft < _worldDimension.getWidth());
-        uint32_t d_rgt = _rgt & -(_rgt <= _lft) & -(_rgt < _worldDimension.getWidth());
-        uint32_t d_top = _top & -(_top <  _btm) & -(_top < _worldDimension.getHeight());
-        uint32_t d_btm = _btm & -(_btm <= _top) & -(_btm < _worldDimension.getHeight());
-
-        // Scale all changes to multiple of 8.
-        d_lft = ((d_lft > 0) + (d_lft >> 3)) << 3;
-        d_rgt = ((d_rgt > 0) + (d_rgt >> 3)) << 3;
-        d_top = ((d_top > 0) + (d_top >> 3)) << 3;
-        d_btm = ((d_btm > 0) + (d_btm >> 3)) << 3;
-
-        // Make sure plate doesn't grow bigger than the system it's in!
-        if (_bounds->width() + d_lft + d_rgt > _worldDimension.getWidth())
-        {
-            d_lft = 0;
-            d_rgt = _worldDimension.getWidth() - _bounds->width();
-        }
+        const uint32_t old_width  = _bounds->width();
+        const uint32_t old_height = _bounds->height();
+        uint32_t d_lft = 0, d_top = 0;
+        growBounds(x, y, d_lft, d_top);
+        growStorage(old_width, old_height, d_lft, d_top);
 
-        if (_bounds->height() + d_top + d_btm > _worldDimension.getHeight())
-        {
-            d_top = 0;
-            d_btm = _worldDimension.getHeight() - _bounds->height();
-        }
+        _x = x, _y = y;
+        index = validMapIndex(&_x, &_y);
 
-        // Index out of bounds, but nowhere to grow!
-        ASSERT(d_lft + d_rgt + d_top + d_btm != 0, "Invalid plate growth deltas");
+        assert(index < _bounds->area());
+    }
 
-        const uint32_t old_width  = _bounds->width();
-        const uint32_t old_height = _bounds->height();
+    setCrust(index, z, t);
+}
 
-        _bounds->shift(-1.0*d_lft, -1.0*d_top);
-        _bounds->grow(d_lft + d_rgt, d_top + d_btm);
+void plate::setCrust(uint32_t index, float z, uint32_t t)
+{
+    if (z < 0) { // Do not accept negative values.
+        z = 0;
+    }
 
-        HeightMap tmph = HeightMap(_bounds->width(), _bounds->height());
-        AgeMap    tmpa = AgeMap(_bounds->width(), _bounds->height());
-        uint32_t* tmps = new uint32_t[_bounds->area()];
-        tmph.set_all(0);
-        tmpa.set_all(0);
-        memset(tmps, 255, _bounds->area()*sizeof(uint32_t));
+    const float old_crust = map[index];
+    if ((old_crust >= CONT_BASE) != (z >= CONT_BASE))
+        markDirty(index);
 
-        // copy old plate into new.
-        for (uint32_t j = 0; j < old_height; ++j)
-        {
-            const uint32_t dest_i = (d_top + j) * _bounds->width() + d_lft;
-            const uint32_t src_i = j * old_width;
-            memcpy(&tmph[dest_i], &map[src_i], old_width *
-                   sizeof(float));
-            memcpy(&tmpa[dest_i], &age_map[src_i], old_width *
-                   sizeof(uint32_t));
-            memcpy(&tmps[dest_i], &_segments->id(src_i), old_width *
-                   sizeof(uint32_t));
-        }
+    writeCrust(index, z, t);
+    updateMass(old_crust, map[index]);
+}
 
-        map     = tmph;
-        age_map = tmpa;
-        _segments->reassign(_bounds->area(), tmps);
+float plate::replaceCrust(uint32_t x, uint32_t y, float z, uint32_t t)
+{
+    return replaceCrust(validMapIndex(&x, &y), z, t);
+}
 
-        // Shift all segment data to match new coordinates.
-        _segments->shift(d_lft, d_top);
+float plate::replaceCrust(uint32_t index, float z, uint32_t t)
+{
+    ASSERT(z >= 0, "Crust must not be negative");
+    const float old_crust = map[index];
+    ASSERT((old_crust >= CONT_BASE) == (z >= CONT_BASE),
+           "Continental crust must be changed with setCrust");
+    writeCrust(index, z, t, false);
+    return old_crust;
+}
 
-        _x = x, _y = y;
-        index = _bounds->getValidMapIndex(&_x, &_y);
+void plate::updateMass(float old_crust, float new_crust)
+{
+    _mass.incMass(-1.0f * old_crust);
+    _mass.incMass(new_crust);      // Update mass counter.
+}
 
-        assert(index < _bounds->area());
-    }
+ContinentId plate::selectCollisionSegment(uint32_t coll_x, uint32_t coll_y)
+{
+    uint32_t index = validMapIndex(&coll_x, &coll_y);
+    ContinentId activeContinent = continentId(index);
+    return activeContinent;
+}
 
+///////////////////////////////////////////////////////////////////////////////
+/// Private methods ///////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+void plate::writeCrust(uint32_t index, float z, uint32_t t, bool list)
+{
     // Update crust's age.
     // If old crust exists, new age is mean of original and supplied ages.
     // If no new crust is added, original time remains intact.
@@ -622,25 +889,98 @@ void plate::setCrust(uint32_t x, uint32_t y, float z, uint32_t t)
     const uint32_t new_crust = -(z > 0);
     t = (t & ~old_crust) | ((uint32_t)((map[index] * age_map[index] + z * t) /
                                        (map[index] + z)) & old_crust);
-    age_map[index] = (t & new_crust) | (age_map[index] & ~new_crust);
+    writeAge(index, (t & new_crust) | (age_map[index] & ~new_crust), list);
+
+    // Tiles with crust are marked already, and their ages are allocated,
+    // which also keeps concurrent replaceCrust calls from writing to the
+    // tiles or allocating.
+    if (z != 0 && map[index] == 0) {
+        _tiles.markIndex(index);
+        reserveAge(age_map, index);
+    }
 
-    _mass.incMass(-1.0f * map[index]);
-    _mass.incMass(z);      // Update mass counter.
     map[index] = z;     // Set new crust height to desired location.
 }
 
-ContinentId plate::selectCollisionSegment(uint32_t coll_x, uint32_t coll_y)
+void plate::writeAge(uint32_t index, uint32_t t, bool list)
 {
-    uint32_t index = _bounds->getValidMapIndex(&coll_x, &coll_y);
-    ContinentId activeContinent = _segments->id(index);
-    return activeContinent;
+    const CrustAge age = narrowAge(t);
+    if (age == age_map[index])
+        return;
+
+    age_map[index] = age;
+    if (list)
+        _young.add(index, age);
 }
 
-///////////////////////////////////////////////////////////////////////////////
-/// Private methods ///////////////////////////////////////////////////////////
-///////////////////////////////////////////////////////////////////////////////
+void plate::growBounds(uint32_t x, uint32_t y, uint32_t& d_lft, uint32_t& d_top)
+{
+    const uint32_t ilft = _bounds->leftAsUint();
+    const uint32_t itop = _bounds->topAsUint();
+    const uint32_t irgt = _bounds->rightAsUintNonInclusive();
+    const uint32_t ibtm = _bounds->bottomAsUintNonInclusive();
+
+    _worldDimension.normalize(x, y);
+
+    // Calculate distance of new point from plate edges.
+    const uint32_t _lft = ilft - x;
+    const uint32_t _rgt = (_worldDimension.getWidth() & -(x < ilft)) + x - irgt;
+    const uint32_t _top = itop - y;
+    const uint32_t _btm = (_worldDimension.getHeight() & -(y < itop)) + y - ibtm;
+
+    // Set larger of horizontal/vertical distance to zero.
+    // A valid distance is NEVER larger than world's side's length!
+    uint32_t lft = _lft & -(_lft <  _rgt) & -(_lft < _worldDimension.getWidth());
+    uint32_t rgt = _rgt & -(_rgt <= _lft) & -(_rgt < _worldDimension.getWidth());
+    uint32_t top = _top & -(_top <  _btm) & -(_top < _worldDimension.getHeight());
+    uint32_t btm = _btm & -(_btm <= _top) & -(_btm < _worldDimension.getHeight());
+
+    // Scale all changes to multiple of 8.
+    lft = ((lft > 0) + (lft >> 3)) << 3;
+    rgt = ((rgt > 0) + (rgt >> 3)) << 3;
+    top = ((top > 0) + (top >> 3)) << 3;
+    btm = ((btm > 0) + (btm >> 3)) << 3;
+
+    // Make sure plate doesn't grow bigger than the system it's in!
+    if (_bounds->width() + lft + rgt > _worldDimension.getWidth())
+    {
+        lft = 0;
+        rgt = _worldDimension.getWidth() - _bounds->width();
+    }
+
+    if (_bounds->height() + top + btm > _worldDimension.getHeight())
+    {
+        top = 0;
+        btm = _worldDimension.getHeight() - _bounds->height();
+    }
+
+    // Index out of bounds, but nowhere to grow!
+    ASSERT(lft + rgt + top + btm != 0, "Invalid plate growth deltas");
+
+    _bounds->shift(-1.0*lft, -1.0*top);
+    _bounds->grow(lft + rgt, top + btm);
+    d_lft += lft;
+    d_top += top;
+}
+
+void plate::growStorage(uint32_t old_width, uint32_t old_height,
+                        uint32_t d_lft, uint32_t d_top)
+{
+    // Storage keeps slack, so the maps are usually re-laid out in place.
+    map.grow(_bounds->width(), _bounds->height(), d_lft, d_top, 0.0f);
+    age_map.grow(_bounds->width(), _bounds->height(), d_lft, d_top, 0);
+    reserveAges(age_map, map);
+    _young.grow(old_width, _bounds->width(), d_lft, d_top);
+    _tiles.grow(_bounds->width(), _bounds->height(), d_lft, d_top);
+    _segments->grow(old_width, old_height,
+                    _bounds->width(), _bounds->height(), d_lft, d_top);
+
+    // Shift all segment data to match new coordinates.
+    _segments->shift(d_lft, d_top);
+    _segmentLabeller.shift(d_lft, d_top);
+}
 
-uint32_t plate::createSegment(uint32_t x, uint32_t y) throw()
+uint32_t plate::createSegment(uint32_t x, uint32_t y)
 {
     return _mySegmentCreator->createSegment(x, y);
 }
@@ -24,6 +24,7 @@
 #include <cmath>     // sin, cos
 #include "simplerandom.hpp"
 #include "heightmap.hpp"
+#include "plate_storage.hpp"
 #include "rectangle.hpp"
 #include "segment_data.hpp"
 #include "utils.hpp"
@@ -31,6 +32,10 @@
 #include "movement.hpp"
 #include "mass.hpp"
 #include "segments.hpp"
+#include "segment_labeller.hpp"
+#include "plate_scratch.hpp"
+#include "tile_occupancy.hpp"
+#include "young_crust.hpp"
 
 class IPlate : public IMass, public IMovement
 {
@@ -52,6 +57,16 @@ public:
     plate(long seed, float* m, uint32_t w, uint32_t h, uint32_t _x, uint32_t _y,
           uint32_t plate_age, WorldDimension worldDimension);
 
+    /// Initializes plate with the supplied height map, taking over its
+    /// storage. The given map is left with a 1x1 placeholder.
+    ///
+    /// @param  m              Height map of terrain.
+    /// @param  _x             X of height map's left-top corner on world map.
+    /// @param  _y             Y of height map's left-top corner on world map.
+    /// @param  worldDimension Dimension of world map's either side in pixels.
+    plate(long seed, HeightMap& m, uint32_t _x, uint32_t _y,
+          uint32_t plate_age, WorldDimension worldDimension);
+
     ~plate();
 
     /// Increment collision counter of the continent at given location.
@@ -61,6 +76,9 @@ public:
     /// @return Surface area of the collided continent (HACK!)
     uint32_t addCollision(uint32_t wx, uint32_t wy);
 
+    /// Same as above for a location given by its index on the plate's map.
+    uint32_t addCollision(uint32_t index);
+
     /// Add crust to plate as result of continental collision.
     ///
     /// @param  x   Location of new crust on global world map (X).
@@ -70,6 +88,22 @@ public:
     /// @param activeContinent Segment ID of the continent that's processed.
     void addCrustByCollision(uint32_t x, uint32_t y, float z, uint32_t t, ContinentId activeContinent);
 
+    /// Add all crust of another plate's continent to this plate.
+    ///
+    /// Same as calling addCrustByCollision for every location of the
+    /// continent in raster order, but the plate is grown only once and
+    /// crust, ages and continent IDs are moved row by row. The crust is
+    /// left in place on the source plate.
+    ///
+    /// @param  src     Plate the continent belongs to.
+    /// @param  seg_id  ID of the continent on the source plate.
+    /// @param  off_x   Offset from source plate's map to world map (X).
+    /// @param  off_y   Offset from source plate's map to world map (Y).
+    /// @param activeContinent Segment ID of the continent that's processed.
+    void addContinent(const plate& src, ContinentId seg_id,
+                      uint32_t off_x, uint32_t off_y,
+                      ContinentId activeContinent);
+
     /// Simulates subduction of oceanic plate under this plate.
     ///
     /// Subduction is simulated by calculating the distance on surface
@@ -132,7 +166,31 @@ public:
     /// Plates total mass and the center of mass are updated.
     ///
     /// @param  lower_bound Sets limit below which there's no erosion.
-    void erode(float lower_bound);
+    /// @param  threads     Number of threads to share the work with. The
+    ///                     result does not depend on it.
+    /// @param  model       How the crust erodes.
+    void erode(float lower_bound, uint32_t threads = 1,
+               ErosionModel model = RIVER_EROSION);
+
+    /// Set the crust at a location inside the plate as the erosion of the
+    /// world's map left it. The age stays, and the plate's mass, tiles and
+    /// continents are left to finishWorldErosion, so that many locations
+    /// can be set concurrently.
+    ///
+    /// @param  x   Offset on the global world map along X axis.
+    /// @param  y   Offset on the global world map along Y axis.
+    /// @param  z   Eroded amount of crust.
+    void setErodedCrust(uint32_t x, uint32_t y, float z);
+
+    /// Bring the plate up to date once setErodedCrust set all locations.
+    void finishWorldErosion();
+
+    /// Drainage of the plate's land as of the last erosion with the flow
+    /// accumulation model. It is laid out like the plate's maps were then,
+    /// and empty if the plate gave its storage back since.
+    const FlowAccumulation& getFlowAccumulation() const {
+        return _scratch.flow;
+    }
 
     /// Retrieve collision statistics of continent at given location.
     ///
@@ -165,14 +223,64 @@ public:
     ///                     Zero is returned if location contains no crust.
     uint32_t getCrustTimestamp(uint32_t x, uint32_t y) const;
 
-    /// Get pointers to plate's data.
+    /// Same as above for a location given by its index on the plate's map.
+    uint32_t getCrustTimestamp(uint32_t index) const {
+        return age_map[index];
+    }
+
+    /// Get read access to plate's data, indexed like the plate's maps.
+    /// Access stays valid until the plate grows or shrinks.
     ///
-    /// @param  c   Adress of crust height map is stored here.
-    /// @param  t   Adress of crust timestamp map is stored here.
-    void getMap(const float** c, const uint32_t** t) const;
+    /// @param  c   Access to crust height map is stored here.
+    /// @param  t   Access to crust timestamp map is stored here.
+    void getMap(CrustView* c, CrustAgeView* t) const;
+
+    /// Set the ages of "count" points from "index" on to ages of the world
+    /// map. The points are not listed by age, see listYoungCrust.
+    template <typename Age>
+    void restoreAges(uint32_t index, const Age* ages, uint32_t count) {
+        narrowAges(age_map, index, ages, count);
+    }
+
+    /// Get the tiles of plate's map that may hold crust.
+    const TileOccupancy& getOccupancy() const throw() {
+        return _tiles;
+    }
+
+    /// Get the points of plate's map by the age of their crust, for the
+    /// ages that were not forgotten yet.
+    const YoungCrust& getYoungCrust() const throw() {
+        return _young;
+    }
+
+    /// List the point at "index" under the current age of its crust.
+    void listYoungPoint(uint32_t index) {
+        _young.add(index, age_map[index]);
+    }
+
+    /// Stop listing the points whose crust is older than "t".
+    void forgetCrustOlderThan(uint32_t t) {
+        _young.forget(t);
+    }
+
+    /// List the points by age again after the age map was written to
+    /// directly, keeping the ages from "oldest" on.
+    void listYoungCrust(uint32_t oldest);
 
     void move(); ///< Moves plate along it's trajectory.
 
+    /// Shrink the plate to the bounding box of its crust.
+    ///
+    /// Plates only grow as they receive crust, while aggregation and
+    /// erosion leave dead areas behind. The maps are cropped only if the
+    /// crust's bounding box covers less than min_ratio of the plate, and
+    /// a plate with no crust left keeps a single point. Continents are
+    /// labelled again by the next resetSegments.
+    ///
+    /// @param  min_ratio   Part of the plate the crust must cover.
+    /// @return             True if the plate was shrunk.
+    bool compact(float min_ratio);
+
     /// Clear any earlier continental crust partitions.
     ///
     /// Plate has an internal bookkeeping of distinct areas of continental
@@ -183,7 +291,10 @@ public:
     ///
     /// To alleviate this problem without the need of per iteration
     /// recalculations plate supplies caller a method to reset its
-    /// bookkeeping and start clean.
+    /// bookkeeping and start clean. The continents present on the plate
+    /// are labelled right away, though only the ones that changed since
+    /// the last reset are actually recalculated; crust that turns
+    /// continental later on is segmented lazily when it's first asked for.
     void resetSegments();
 
     /// Remember the currently processed continent's segment number.
@@ -203,6 +314,36 @@ public:
     /// @param  t   Time of creation of new crust.
     void setCrust(uint32_t x, uint32_t y, float z, uint32_t t);
 
+    /// Same as above for a location given by its index on the plate's map,
+    /// which therefore needs no growing.
+    void setCrust(uint32_t index, float z, uint32_t t);
+
+    /// Set the amount of crust at a location inside the plate, leaving the
+    /// plate's mass untouched.
+    ///
+    /// Meant for callers that modify many locations concurrently: they
+    /// apply the returned change with updateMass afterwards, in the order
+    /// setCrust would have done it, and list the location with
+    /// listYoungPoint if its age changed. The location must stay on the
+    /// same side of CONT_BASE, since continents are not told about the
+    /// change.
+    ///
+    /// @param  x   Offset on the global world map along X axis.
+    /// @param  y   Offset on the global world map along Y axis.
+    /// @param  z   Amount of crust at given location, must not be negative.
+    /// @param  t   Time of creation of new crust.
+    /// @return     Amount of crust the location had before.
+    float replaceCrust(uint32_t x, uint32_t y, float z, uint32_t t);
+
+    /// Same as above for a location given by its index on the plate's map.
+    float replaceCrust(uint32_t index, float z, uint32_t t);
+
+    /// Account for crust changed by replaceCrust in plate's mass.
+    ///
+    /// @param  old_crust   Amount of crust before the change.
+    /// @param  new_crust   Amount of crust after the change.
+    void updateMass(float old_crust, float new_crust);
+
     float getMass() const throw() {
         return _mass.getMass();
     }
@@ -274,6 +415,8 @@ public:
     {
         delete _segments;
         _segments = segments;
+        _mySegments = NULL;
+        _segmentLabeller.markAllDirty();
     }
 
     // Visible for testing
@@ -281,25 +424,74 @@ public:
     {
         delete _bounds;
         _bounds = bounds;
+        _myBounds = NULL;
     }
 
 private:
 
+    void init(uint32_t _x, uint32_t _y, uint32_t plate_age);
     ISegmentData& getContinentAt(int x, int y);
     const ISegmentData& getContinentAt(int x, int y) const;
-    void findRiverSources(float lower_bound, vector<uint32_t>* sources);
-    void flowRivers(float lower_bound, vector<uint32_t>* sources, HeightMap& tmp);
-    uint32_t createSegment(uint32_t x, uint32_t y) throw();
+    void findRiverSources(float lower_bound, uint32_t y0, uint32_t y1,
+                          vector<uint32_t>* sources);
+    void addNoise(HeightMap& tmpHm, SimpleRandom random, uint32_t y0, uint32_t y1);
+    void flowRivers(float lower_bound, vector<uint32_t>* sources,
+                    HeightMap& tmp, uint32_t threads);
+    void erodeByRivers(float lower_bound, HeightMap& tmpHm, uint32_t threads);
+    void erodeByFlow(float lower_bound, HeightMap& tmpHm);
+    void flowRiver(uint32_t index, float lower_bound, HeightMap& tmp,
+                   vector<uint32_t>& sinks);
+    uint32_t createSegment(uint32_t x, uint32_t y);
+    void writeCrust(uint32_t index, float z, uint32_t t, bool list = true);
+    void writeAge(uint32_t index, uint32_t t, bool list = true);
+    /// Extend bounds to contain world location (x, y). Adds the growth on
+    /// the left and top sides to d_lft and d_top, maps are left untouched.
+    void growBounds(uint32_t x, uint32_t y, uint32_t& d_lft, uint32_t& d_top);
+    /// Lay the maps out for bounds grown by growBounds.
+    void growStorage(uint32_t old_width, uint32_t old_height,
+                     uint32_t d_lft, uint32_t d_top);
+    void markDirty(uint32_t index);
+
+    /// Map index of world location (x, y), see IBounds::getMapIndex.
+    uint32_t mapIndex(uint32_t* x, uint32_t* y) const
+    {
+        return _myBounds ? _myBounds->getMapIndex(x, y) : _bounds->getMapIndex(x, y);
+    }
+    /// Map index of world location (x, y), see IBounds::getValidMapIndex.
+    uint32_t validMapIndex(uint32_t* x, uint32_t* y) const
+    {
+        return _myBounds ? _myBounds->getValidMapIndex(x, y)
+                         : _bounds->getValidMapIndex(x, y);
+    }
+    /// Continent that the point at index belongs to.
+    ContinentId continentId(uint32_t index) const
+    {
+        return _mySegments ? _mySegments->id(index) : _segments->id(index);
+    }
+    /// Hand the point at index to continent id.
+    void setContinentId(uint32_t index, ContinentId id)
+    {
+        if (_mySegments)
+            _mySegments->setId(index, id);
+        else
+            _segments->setId(index, id);
+    }
 
     const WorldDimension _worldDimension;
     SimpleRandom _randsource;
-    HeightMap map;        ///< Bitmap of plate's structure/height.
-    AgeMap age_map;       ///< Bitmap of plate's soil's age: timestamp of creation.
+    CrustMap map;         ///< Bitmap of plate's structure/height.
+    CrustAgeMap age_map;  ///< Bitmap of plate's soil's age: timestamp of creation.
     IBounds* _bounds;
+    Bounds* _myBounds;     ///< _bounds unless a test injected other bounds.
     Mass _mass;
     Movement _movement;
     ISegments* _segments;
+    Segments* _mySegments; ///< _segments unless a test injected others.
     MySegmentCreator* _mySegmentCreator;
+    SegmentLabeller _segmentLabeller;
+    PlateScratch _scratch; ///< Buffers of erosion and segmentation.
+    TileOccupancy _tiles;  ///< Parts of the maps that may hold crust.
+    YoungCrust _young;     ///< Points of the map by age of their crust.
 };
 
 #endif
@@ -0,0 +1,66 @@
+/******************************************************************************
+ *  plate-tectonics, a plate tectonics simulation library
+ *  Copyright (C) 2012-2013 Lauri Viitanen
+ *  Copyright (C) 2014-2015 Federico Tomassetti, Bret Curtis
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, see http://www.gnu.org/licenses/
+ *****************************************************************************/
+
+#ifndef PLATE_SCRATCH_HPP
+#define PLATE_SCRATCH_HPP
+
+#include <vector>
+#include "heightmap.hpp"
+#include "erosion_stencil.hpp"
+#include "flow_accumulation.hpp"
+
+/// Working buffers of a plate's kernels, kept between steps.
+///
+/// Each plate owns one, so plates can erode and find their continents at the
+/// same time, and simulations running on different threads share nothing.
+class PlateScratch
+{
+public:
+    PlateScratch() : erosion(1, 1), crust(1, 1) {}
+
+    /// Give back the storage, e.g. when the plate shrank.
+    void release() {
+        releaseErosion();
+        flow = FlowAccumulation();
+    }
+
+    /// Give back the buffers of erosion, except for the drainage.
+    void releaseErosion() {
+        HeightMap(1, 1).swap(erosion);
+        HeightMap(1, 1).swap(crust);
+        std::vector<ErosionStencil>().swap(erosionStencils);
+        std::vector<std::vector<uint32_t> >().swap(bandSources);
+        std::vector<uint32_t>().swap(sources);
+        std::vector<uint64_t>().swap(flowDone);
+        std::vector<double>().swap(noise);
+    }
+
+    HeightMap erosion;                   ///< Height map being eroded.
+    std::vector<uint32_t> sources;       ///< River points of this round.
+    std::vector<uint64_t> flowDone;      ///< Bitmap of points rivers reached.
+    std::vector<double> noise;           ///< Random values of erosion noise.
+    std::vector<ErosionStencil> erosionStencils; ///< One per band of rows.
+    std::vector<std::vector<uint32_t> > bandSources; ///< River points per band or thread.
+    HeightMap crust;                     ///< Compact plate's crust as floats.
+    FlowAccumulation flow;               ///< Drainage of the last erosion.
+    std::vector<std::vector<uint32_t> > spansTodo; ///< Per row spans left to fill.
+    std::vector<std::vector<uint32_t> > spansDone; ///< Per row spans filled.
+};
+
+#endif
@@ -0,0 +1,280 @@
+/******************************************************************************
+ *  plate-tectonics, a plate tectonics simulation library
+ *  Copyright (C) 2012-2013 Lauri Viitanen
+ *  Copyright (C) 2014-2015 Federico Tomassetti, Bret Curtis
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, see http://www.gnu.org/licenses/
+ *****************************************************************************/
+
+#ifndef PLATE_STORAGE_HPP
+#define PLATE_STORAGE_HPP
+
+#include "utils.hpp"
+#include "half.hpp"
+#include "heightmap.hpp"
+#include "tiled_matrix.hpp"
+#include "movement.hpp"
+
+// Types of the values a plate keeps for each of its points.
+//
+// By default a point costs 4 bytes of crust, 4 bytes of age and 4 bytes of
+// continent id. Built with PLATEC_COMPACT_PLATES (cmake option
+// WITH_COMPACT_PLATES) each of them takes 2 bytes instead: crust is a half
+// float, ages and ids are 16 bits. Computations still happen in float and
+// uint32_t, only the stored values are narrowed. The world maps are not
+// affected.
+//
+// The maps of a plate cover its whole bounding box. Built with
+// PLATEC_SPARSE_PLATES (cmake option WITH_SPARSE_PLATES) they are kept in
+// tiles of TiledMatrix instead, which are allocated only where crust, ages
+// or continents are, so plates that wrap or stretch across the world cost
+// about as much as their crust. Reaching a point by its index then takes
+// a division, and erosion still works on a dense copy of the plate while
+// it runs.
+
+#ifdef PLATEC_COMPACT_PLATES
+
+/// Amount of crust at a point of a plate, stored as a half float.
+///
+/// The rounding never lifts crust from below CONT_BASE to CONT_BASE, so a
+/// point is continental exactly when the value it was given is.
+class Crust
+{
+public:
+    Crust() {}
+    Crust(float value) : _bits(narrow(value)) {}
+
+    operator float() const {
+        return Platec::halfToFloat(_bits);
+    }
+    Crust& operator+=(float delta) {
+        _bits = narrow(Platec::halfToFloat(_bits) + delta);
+        return *this;
+    }
+    Crust& operator-=(float delta) {
+        _bits = narrow(Platec::halfToFloat(_bits) - delta);
+        return *this;
+    }
+
+private:
+    static uint16_t narrow(float value) {
+        const uint16_t bits = Platec::floatToHalf(value);
+        return bits - (value < CONT_BASE && Platec::halfToFloat(bits) >= CONT_BASE);
+    }
+
+    uint16_t _bits;
+};
+
+/// Tiled maps of crust are read as floats, see TiledMatrix::Ref.
+template <>
+struct TiledRead<Crust>
+{
+    typedef float type;
+};
+
+/// Creation time of the crust at a point of a plate. The iteration count
+/// starts over with every cycle, which is over after a few hundred steps.
+typedef uint16_t CrustAge;
+
+/// Continent segment of a point of a plate.
+typedef uint16_t ContinentId;
+
+#else
+
+typedef float Crust;
+typedef uint32_t CrustAge;
+typedef uint32_t ContinentId;
+
+#endif
+
+/// Number of continents a plate can tell apart. The largest ContinentId
+/// marks the points that belong to no continent.
+const uint32_t MAX_CONTINENTS = (ContinentId)-1;
+
+#ifdef PLATEC_SPARSE_PLATES
+
+typedef TiledMatrix<Crust> CrustMap;
+typedef TiledMatrix<CrustAge> CrustAgeMap;
+typedef TiledMatrix<ContinentId> ContinentIdMap;
+
+/// Read-only access to a plate's maps by index, see plate::getMap.
+typedef TiledView<Crust> CrustView;
+typedef TiledView<CrustAge> CrustAgeView;
+
+#else
+
+typedef Matrix<Crust> CrustMap;
+typedef Matrix<CrustAge> CrustAgeMap;
+typedef Matrix<ContinentId> ContinentIdMap;
+
+typedef const Crust* CrustView;
+typedef const CrustAge* CrustAgeView;
+
+#endif
+
+/// Read-only access to the values of a map by index.
+template <typename Value>
+inline const Value* mapView(const Matrix<Value>& map)
+{
+    return map.raw_data();
+}
+
+template <typename Value>
+inline TiledView<Value> mapView(const TiledMatrix<Value>& map)
+{
+    return TiledView<Value>(map);
+}
+
+/// Values of row y of a map from column x on, up to column "end", which is
+/// set to the end of the row, or of the tile of (x, y) for tiled maps.
+/// NULL if they are all the fill value of a tiled map.
+template <typename Value>
+inline const Value* mapRun(const Matrix<Value>& map, uint32_t x, uint32_t y,
+                           uint32_t& end)
+{
+    end = map.width();
+    return &map.raw_data()[y * map.width() + x];
+}
+
+template <typename Value>
+inline const Value* mapRun(const TiledMatrix<Value>& map, uint32_t x, uint32_t y,
+                           uint32_t& end)
+{
+    return map.run(x, y, end);
+}
+
+/// Allocate the age of the point at "index", so that the point's crust can
+/// be changed concurrently with other points of the plate. Only sparse
+/// plates allocate when written to.
+inline void reserveAge(CrustAgeMap& ages, uint32_t index)
+{
+#ifdef PLATEC_SPARSE_PLATES
+    ages.reserve(index % ages.width(), index / ages.width());
+#endif
+}
+
+/// Same as above for every point of the plate that may hold crust.
+inline void reserveAges(CrustAgeMap& ages, const CrustMap& crust)
+{
+#ifdef PLATEC_SPARSE_PLATES
+    ages.reserveLike(crust);
+#endif
+}
+
+/// Age as stored by a plate. Ages that do not fit saturate.
+inline CrustAge narrowAge(uint32_t t)
+{
+#ifdef PLATEC_COMPACT_PLATES
+    return t < 0xFFFF ? (CrustAge)t : (CrustAge)0xFFFF;
+#else
+    return t;
+#endif
+}
+
+/// Change of the crust stored at a point holding "crust" once "delta" is
+/// added to it, which compact plates round.
+inline float crustChange(float crust, float delta)
+{
+#ifdef PLATEC_COMPACT_PLATES
+    return (float)Crust(crust + delta) - crust;
+#else
+    return delta;
+#endif
+}
+
+/// Store "count" ages of the world map in a plate's age map, from "index"
+/// on.
+template <typename Age>
+void narrowAges(CrustAgeMap& dst, uint32_t index, const Age* src, uint32_t count)
+{
+    for (uint32_t i = 0; i < count; ++i)
+        dst[index + i] = narrowAge(src[i]);
+}
+
+/// Move the values of a height map into a plate's crust. The height map is
+/// left with a 1x1 placeholder, its storage is taken over when possible.
+inline void adoptCrust(CrustMap& crust, HeightMap& m)
+{
+#if defined(PLATEC_SPARSE_PLATES)
+    CrustMap(m.width(), m.height()).swap(crust);
+    crust.assign(m.raw_data());
+    HeightMap(1, 1).swap(m);
+#elif defined(PLATEC_COMPACT_PLATES)
+    CrustMap(m.width(), m.height()).swap(crust);
+    for (uint32_t i = 0; i < m.area(); ++i)
+        crust[i] = m[i];
+    HeightMap(1, 1).swap(m);
+#else
+    crust.swap(m);
+    HeightMap(1, 1).swap(m);
+#endif
+}
+
+/// Same as above for an array of w * h values allocated with new[].
+inline void adoptCrust(CrustMap& crust, float* m, uint32_t w, uint32_t h)
+{
+    HeightMap heights(m, w, h);
+    adoptCrust(crust, heights);
+}
+
+/// Copy a plate's crust into a float map, for work that needs full precision.
+inline void widenCrust(HeightMap& dst, const CrustMap& src)
+{
+#if defined(PLATEC_SPARSE_PLATES)
+    if (dst.width() != src.width() || dst.height() != src.height())
+        HeightMap(src.width(), src.height()).swap(dst);
+    src.copyTo(dst.raw_data());
+#elif defined(PLATEC_COMPACT_PLATES)
+    if (dst.width() != src.width() || dst.height() != src.height())
+        HeightMap(src.width(), src.height()).swap(dst);
+    for (uint32_t i = 0; i < src.area(); ++i)
+        dst[i] = src[i];
+#else
+    dst.copy(src);
+#endif
+}
+
+/// The values of a plate's crust as floats: the map's own storage unless
+/// the plate is compact or sparse, in which case "scratch" is filled with
+/// them.
+inline const float* crustValues(const CrustMap& crust, HeightMap& scratch)
+{
+#if defined(PLATEC_COMPACT_PLATES) || defined(PLATEC_SPARSE_PLATES)
+    widenCrust(scratch, crust);
+    return scratch.raw_data();
+#else
+    return crust.raw_data();
+#endif
+}
+
+/// Store the float map back into a plate's crust. The float map is left
+/// with unspecified values of the same size. Tiles of sparse plates that
+/// are left without crust are given back.
+inline void narrowCrust(CrustMap& dst, HeightMap& src)
+{
+#if defined(PLATEC_SPARSE_PLATES)
+    ASSERT(dst.width() == src.width() && dst.height() == src.height(),
+           "Crust and height map must be of the same size");
+    dst.assign(src.raw_data());
+#elif defined(PLATEC_COMPACT_PLATES)
+    ASSERT(dst.width() == src.width() && dst.height() == src.height(),
+           "Crust and height map must be of the same size");
+    for (uint32_t i = 0; i < src.area(); ++i)
+        dst[i] = src[i];
+#else
+    dst.swap(src);
+#endif
+}
+
+#endif
@@ -20,6 +20,7 @@
 #include "lithosphere.hpp"
 #include "plate.hpp"
 #include "platecapi.hpp"
+#include "parallel.hpp"
 #include <stdlib.h>
 #include <stdio.h>
 
@@ -37,6 +38,9 @@ public:
 
 extern lithosphere* platec_api_get_lithosphere(uint32_t);
 
+// Simulations may be created and stepped from many threads at once. Each
+// lithosphere keeps to its own state, only this registry is shared.
+static Platec::Mutex registry_mutex;
 static std::vector<platec_api_list_elem> lithospheres;
 static uint32_t last_id = 1;
 
@@ -53,6 +57,7 @@ void* platec_api_create(long seed, uint32_t width, uint32_t height, float sea_le
                                          erosion_period, folding_ratio, aggr_overlap_abs,
                                          aggr_overlap_rel, cycle_count, num_plates);
 
+    Platec::MutexLock lock(registry_mutex);
     platec_api_list_elem elem(++last_id, litho);
     lithospheres.push_back(elem);
 
@@ -61,6 +66,7 @@ void* platec_api_create(long seed, uint32_t width, uint32_t height, float sea_le
 
 void platec_api_destroy(void* litho)
 {
+    Platec::MutexLock lock(registry_mutex);
     for (uint32_t i = 0; i < lithospheres.size(); ++i)
         if (lithospheres[i].data == litho) {
             lithospheres.erase(lithospheres.begin()+i);
@@ -93,6 +99,7 @@ uint32_t* platec_api_get_platesmap(void *pointer)
 
 lithosphere* platec_api_get_lithosphere(uint32_t id)
 {
+    Platec::MutexLock lock(registry_mutex);
     for (uint32_t i = 0; i < lithospheres.size(); ++i)
         if (lithospheres[i].id == id)
             return lithospheres[i].data;
@@ -116,6 +123,31 @@ void platec_api_step(void *pointer)
     litho->update();
 }
 
+void platec_api_set_thread_count(void *pointer, uint32_t num_threads)
+{
+    lithosphere* litho = (lithosphere*)pointer;
+    litho->setThreadCount(num_threads);
+}
+
+void platec_api_set_compaction_ratio(void *pointer, float ratio)
+{
+    lithosphere* litho = (lithosphere*)pointer;
+    litho->setCompactionRatio(ratio);
+}
+
+void platec_api_set_erosion_model(void *pointer, uint32_t model)
+{
+    lithosphere* litho = (lithosphere*)pointer;
+    litho->setErosionModel(model == FLOW_ACCUMULATION_EROSION ?
+                           FLOW_ACCUMULATION_EROSION : RIVER_EROSION);
+}
+
+void platec_api_set_world_erosion(void *pointer, uint32_t enabled)
+{
+    lithosphere* litho = (lithosphere*)pointer;
+    litho->setWorldErosion(enabled != 0);
+}
+
 uint32_t lithosphere_getMapWidth ( void* object)
 {
     return static_cast<lithosphere*>( object)->getWidth();
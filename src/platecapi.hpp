@@ -39,6 +39,21 @@ uint32_t* platec_api_get_platesmap(void*);
 uint32_t  platec_api_is_finished(void*);
 void    platec_api_step(void*);
 
+/// Set the number of threads used by the simulation, 0 uses all cores.
+void    platec_api_set_thread_count(void*, uint32_t num_threads);
+
+/// Shrink plates whose crust covers less than the given part of their
+/// bounds, 0 disables it. Changes the outcome of the simulation.
+void    platec_api_set_compaction_ratio(void*, float ratio);
+
+/// Choose how plates erode: 0 walks rivers down from the tops (the
+/// default), 1 erodes by flow accumulation. Changes the outcome.
+void    platec_api_set_erosion_model(void*, uint32_t model);
+
+/// Erode the world as the plates compose it instead of each plate on its
+/// own when "enabled" is non-zero. Changes the outcome.
+void    platec_api_set_world_erosion(void*, uint32_t enabled);
+
 float platec_api_velocity_unity_vector_x(void*, uint32_t plate_index);
 float platec_api_velocity_unity_vector_y(void*, uint32_t plate_index);
 
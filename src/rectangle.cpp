@@ -83,4 +83,30 @@ void Rectangle::enlarge_to_contain(uint32_t x, uint32_t y)
     }
 }
 
-}
\ No newline at end of file
+WrappedRect::WrappedRect(const WorldDimension& world, uint32_t left,
+                         uint32_t top, uint32_t width, uint32_t height)
+{
+    ASSERT(width <= world.getWidth() && height <= world.getHeight(),
+           "Plate can't be larger than the world");
+    _numColumns = split(left % world.getWidth(), width, world.getWidth(),
+                        _columns);
+    _numRows = split(top % world.getHeight(), height, world.getHeight(),
+                     _rows);
+}
+
+uint32_t WrappedRect::split(uint32_t start, uint32_t length, uint32_t size,
+                            WrappedSpan* spans)
+{
+    const uint32_t first = length < size - start ? length : size - start;
+
+    spans[0].plate = 0;
+    spans[0].world = start;
+    spans[0].length = first;
+    spans[1].plate = first;
+    spans[1].world = 0;
+    spans[1].length = length - first;
+
+    return length > first ? 2 : 1;
+}
+
+}
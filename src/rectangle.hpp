@@ -122,6 +122,63 @@ private:
     uint32_t _top, _bottom;
 };
 
+/// Rows or columns of a plate that land on the world without wrapping.
+struct WrappedSpan
+{
+    uint32_t plate;  ///< First row/column on the plate.
+    uint32_t world;  ///< Row/column of the world it lands on.
+    uint32_t length; ///< Number of rows/columns.
+};
+
+/// A plate's area cut along the edges of the world.
+///
+/// Plate's columns are split in at most two spans, and so are its rows,
+/// making up to four sub-rectangles that don't cross the world's edges.
+/// Any row of a sub-rectangle is contiguous both on the plate's map and
+/// on the world's map, so it can be copied or looped over with neither
+/// modulus nor wrap checks. Spans are in plate order: visiting the row
+/// spans, their rows and then the column spans goes through the plate's
+/// map from start to end.
+class WrappedRect
+{
+public:
+    /// @param  world   Dimension of the world, plate can't be any larger.
+    /// @param  left    Plate's left edge on the world.
+    /// @param  top     Plate's top edge on the world.
+    /// @param  width   Width of the plate.
+    /// @param  height  Height of the plate.
+    WrappedRect(const WorldDimension& world, uint32_t left, uint32_t top,
+                uint32_t width, uint32_t height);
+
+    uint32_t columnSpans() const
+    {
+        return _numColumns;
+    }
+
+    uint32_t rowSpans() const
+    {
+        return _numRows;
+    }
+
+    const WrappedSpan& columnSpan(uint32_t index) const
+    {
+        return _columns[index];
+    }
+
+    const WrappedSpan& rowSpan(uint32_t index) const
+    {
+        return _rows[index];
+    }
+
+private:
+    static uint32_t split(uint32_t start, uint32_t length, uint32_t size,
+                          WrappedSpan* spans);
+
+    WrappedSpan _columns[2];
+    WrappedSpan _rows[2];
+    uint32_t _numColumns, _numRows;
+};
+
 };
 
 
@@ -17,6 +17,8 @@
  *  License along with this library; if not, see http://www.gnu.org/licenses/
  *****************************************************************************/
 
+#include <stdexcept> // std::runtime_error
+
 #include "segment_creator.hpp"
 #include "movement.hpp"
 #include "segments.hpp"
@@ -82,7 +84,7 @@ void MySegmentCreator::scanSpans(const uint32_t line, uint32_t& start, uint32_t&
     } while (start > end && spans_todo[line].size());
 }
 
-ContinentId MySegmentCreator::createSegment(uint32_t x, uint32_t y) const throw()
+ContinentId MySegmentCreator::createSegment(uint32_t x, uint32_t y) const
 {
     const uint32_t bounds_width = _bounds.width();
     const uint32_t bounds_height = _bounds.height();
@@ -105,22 +107,22 @@ ContinentId MySegmentCreator::createSegment(uint32_t x, uint32_t y) const throw(
         return nbour_id;
     }
 
+    if (ID >= MAX_CONTINENTS)
+        throw std::runtime_error("Too many continents for ContinentId");
+
     uint32_t lines_processed;
     Platec::Rectangle rect(_worldDimension, x, x, y, y);
-    SegmentData* pData = new SegmentData(rect, 0);
-    static vector<uint32_t>* spans_todo = NULL;
-    static vector<uint32_t>* spans_done = NULL;
-    static uint32_t spans_size = 0;
+    SegmentData data(rect, 0);
     // MK: This code was originally allocating the 2D arrays per function call.
     // This was eating up a tremendous amount of cpu.
-    // They are now static and they grow as needed, which turns out to be seldom.
-    if (spans_size < bounds_height) {
-        delete[] spans_todo;
-        delete[] spans_done;
-        spans_todo = new vector<uint32_t>[bounds_height];
-        spans_done = new vector<uint32_t>[bounds_height];
-        spans_size = bounds_height;
+    // They are now kept in the plate's scratch and grow as needed, which
+    // turns out to be seldom.
+    if (_scratch.spansTodo.size() < bounds_height) {
+        _scratch.spansTodo.resize(bounds_height);
+        _scratch.spansDone.resize(bounds_height);
     }
+    vector<uint32_t>* spans_todo = &_scratch.spansTodo[0];
+    vector<uint32_t>* spans_done = &_scratch.spansDone[0];
     _segments->setId(origin_index, ID);
     spans_todo[y].push_back(x);
     spans_todo[y].push_back(x);
@@ -193,13 +195,13 @@ ContinentId MySegmentCreator::createSegment(uint32_t x, uint32_t y) const throw(
                 // Count volume of pixel...
             }
 
-            pData->incArea(1 + end - start); // Update segment area counter.
+            data.incArea(1 + end - start); // Update segment area counter.
 
             // Record any changes in extreme dimensions.
-            if (line < pData->getTop()) pData->setTop(line);
-            if (line > pData->getBottom()) pData->setBottom(line);
-            if (start < pData->getLeft()) pData->setLeft(start);
-            if (end > pData->getRight()) pData->setRight(end);
+            if (line < data.getTop()) data.setTop(line);
+            if (line > data.getBottom()) data.setBottom(line);
+            if (start < data.getLeft()) data.setLeft(start);
+            if (end > data.getRight()) data.setRight(end);
 
             if (line > 0 || bounds_height == _worldDimension.getHeight()) {
                 for (uint32_t j = start; j <= end; ++j)
@@ -265,7 +267,7 @@ ContinentId MySegmentCreator::createSegment(uint32_t x, uint32_t y) const throw(
         spans_todo[line].clear();
         spans_done[line].clear();
     }
-    _segments->add(pData);
+    _segments->add(data);
 
     return ID;
 }
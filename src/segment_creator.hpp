@@ -23,11 +23,11 @@
 #include <vector>
 #include "utils.hpp"
 #include "heightmap.hpp"
+#include "plate_storage.hpp"
+#include "plate_scratch.hpp"
 
-typedef uint32_t ContinentId;
-
-class IBounds;
-class ISegments;
+class Bounds;
+class Segments;
 
 class ISegmentCreator
 {
@@ -38,10 +38,10 @@ public:
 class MySegmentCreator : public ISegmentCreator
 {
 public:
-    MySegmentCreator(IBounds& bounds, ISegments* segments, HeightMap& map_,
-                     const WorldDimension& worldDimension)
+    MySegmentCreator(Bounds& bounds, Segments* segments, const CrustMap& map_,
+                     const WorldDimension& worldDimension, PlateScratch& scratch)
         : _bounds(bounds), _segments(segments), map(map_),
-          _worldDimension(worldDimension)
+          _worldDimension(worldDimension), _scratch(scratch)
     {
 
     }
@@ -53,15 +53,17 @@ public:
     /// @param	x	Offset on the local height map along X axis.
     /// @param	y	Offset on the local height map along Y axis.
     /// @return	ID of created segment on success, otherwise -1.
-    ContinentId createSegment(uint32_t wx, uint32_t wy) const throw();
+    /// @throw	std::runtime_error if the plate has run out of continent IDs.
+    ContinentId createSegment(uint32_t wx, uint32_t wy) const;
 private:
     uint32_t calcDirection(uint32_t x, uint32_t y, const uint32_t origin_index, const uint32_t ID) const;
     void scanSpans(const uint32_t line, uint32_t& start, uint32_t& end,
                    std::vector<uint32_t>* spans_todo, std::vector<uint32_t>* spans_done) const;
     const WorldDimension _worldDimension;
-    IBounds& _bounds;
-    ISegments* _segments;
-    HeightMap& map;
+    Bounds& _bounds;     ///< Concrete types, so the fill calls them directly.
+    Segments* _segments;
+    const CrustMap& map;
+    PlateScratch& _scratch; ///< Holds the span lists of createSegment.
 };
 
 #endif
@@ -23,6 +23,17 @@ SegmentData::SegmentData(const Platec::Rectangle& rectangle,
                          uint32_t area) : _rectangle(rectangle),
     _area(area), _coll_count(0) {};
 
+SegmentData& SegmentData::operator=(const SegmentData& other)
+{
+    _rectangle.setLeft(other.getLeft());
+    _rectangle.setRight(other.getRight());
+    _rectangle.setTop(other.getTop());
+    _rectangle.setBottom(other.getBottom());
+    _area = other._area;
+    _coll_count = other._coll_count;
+    return *this;
+}
+
 void SegmentData::enlarge_to_contain(uint32_t x, uint32_t y)
 {
     _rectangle.enlarge_to_contain(x, y);
@@ -81,6 +92,11 @@ bool SegmentData::isEmpty() const
 void SegmentData::incCollCount()
 {
     _coll_count++;
+}
+
+void SegmentData::resetCollCount()
+{
+    _coll_count = 0;
 };
 
 void SegmentData::incArea()
@@ -39,19 +39,25 @@ class ISegmentData : public ISegmentDataAccess
 {
 public:
     virtual void incCollCount() = 0;
+    virtual void resetCollCount() = 0;
     virtual void incArea() = 0;
+    virtual void incArea(uint32_t amount) = 0;
     virtual void enlarge_to_contain(uint32_t x, uint32_t y) = 0;
     virtual void markNonExistent() = 0;
     virtual void shift(uint32_t dx, uint32_t dy) = 0;
 };
 
 /// Container for details about a segmented crust area on this plate.
-class SegmentData : public ISegmentData
+class SegmentData PLATEC_FINAL : public ISegmentData
 {
 public:
     SegmentData(const Platec::Rectangle& rectangle,
                 uint32_t area);
 
+    /// Copy the other segment's details. Segments of one plate share the
+    /// world, so the world dimension is left as it is.
+    SegmentData& operator=(const SegmentData& other);
+
     void enlarge_to_contain(uint32_t x, uint32_t y);
     uint32_t getLeft() const;
     uint32_t getRight() const;
@@ -64,6 +70,7 @@ public:
     void setBottom(uint32_t v);
     bool isEmpty() const;
     void incCollCount();
+    void resetCollCount();
     void incArea();
     void incArea(uint32_t amount);
     uint32_t area() const;
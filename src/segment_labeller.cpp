@@ -0,0 +1,427 @@
+/******************************************************************************
+ *  plate-tectonics, a plate tectonics simulation library
+ *  Copyright (C) 2012-2013 Lauri Viitanen
+ *  Copyright (C) 2014-2015 Federico Tomassetti, Bret Curtis
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, see http://www.gnu.org/licenses/
+ *****************************************************************************/
+
+#include <stdexcept> // std::runtime_error
+
+#include "segment_labeller.hpp"
+#include "segments.hpp"
+#include "tile_occupancy.hpp"
+
+SegmentLabeller::SegmentLabeller(const WorldDimension& worldDimension)
+    : _worldDimension(worldDimension), _words(0), _relabelAll(true)
+{
+}
+
+static const ContinentId UNLABELLED = (ContinentId)-1;
+
+// Mask words and tiles are both 64 points wide, so the words of empty
+// tiles are simply left clear, as are the ones of missing tiles of sparse
+// plates.
+void SegmentLabeller::buildMask(const CrustMap& map, uint32_t width, uint32_t height,
+                                const TileOccupancy* tiles)
+{
+    _words = (width + 63) / 64;
+    _mask.assign(_words * height, 0);
+
+    for (uint32_t y = 0; y < height; ++y)
+    {
+        uint64_t* row = &_mask[y * _words];
+
+        for (uint32_t w = 0; w < _words; ++w)
+        {
+            const uint32_t x0 = w * 64;
+            if (tiles && !tiles->occupied(x0, y))
+                continue;
+
+            uint32_t end;
+            const Crust* line = mapRun(map, x0, y, end);
+            if (line == NULL)
+                continue;
+
+            const uint32_t x1 = x0 + 64 < width ? x0 + 64 : width;
+            uint64_t bits = 0;
+
+            for (uint32_t x = x0; x < x1; ++x)
+                bits |= (uint64_t)(line[x - x0] >= CONT_BASE) << (x - x0);
+
+            row[w] = bits;
+        }
+    }
+}
+
+uint32_t SegmentLabeller::nextSet(const uint64_t* row, uint32_t from,
+                                  uint32_t width) const
+{
+    uint32_t w = from / 64;
+    if (w >= _words)
+        return width;
+
+    uint64_t bits = row[w] & (~(uint64_t)0 << (from % 64));
+    while (bits == 0) {
+        if (++w == _words)
+            return width;
+        bits = row[w];
+    }
+
+    return w * 64 + Platec::lowestBit(bits);
+}
+
+uint32_t SegmentLabeller::nextClear(const uint64_t* row, uint32_t from,
+                                    uint32_t width) const
+{
+    uint32_t w = from / 64;
+    if (w >= _words)
+        return width;
+
+    // Bits past the plate's width are clear, so there's always an end.
+    uint64_t bits = ~row[w] & (~(uint64_t)0 << (from % 64));
+    while (bits == 0) {
+        if (++w == _words)
+            return width;
+        bits = ~row[w];
+    }
+
+    const uint32_t x = w * 64 + Platec::lowestBit(bits);
+    return x < width ? x : width;
+}
+
+void SegmentLabeller::findRuns(uint32_t width, uint32_t height)
+{
+    _runStart.clear();
+    _runEnd.clear();
+    _rowRuns.resize(height + 1);
+
+    for (uint32_t y = 0; y < height; ++y)
+    {
+        const uint64_t* row = &_mask[y * _words];
+        _rowRuns[y] = (uint32_t)_runStart.size();
+
+        uint32_t x = nextSet(row, 0, width);
+        while (x < width)
+        {
+            const uint32_t end = nextClear(row, x, width);
+            _runStart.push_back(x);
+            _runEnd.push_back(end - 1);
+            x = nextSet(row, end, width);
+        }
+    }
+
+    _rowRuns[height] = (uint32_t)_runStart.size();
+}
+
+uint32_t SegmentLabeller::root(uint32_t run)
+{
+    while (_parent[run] != run) {
+        _parent[run] = _parent[_parent[run]];
+        run = _parent[run];
+    }
+    return run;
+}
+
+// The root of a continent is always its first run in scan order, which
+// lets the labelling pass number continents in the order they are met.
+void SegmentLabeller::join(uint32_t a, uint32_t b)
+{
+    a = root(a);
+    b = root(b);
+    if (a < b)
+        _parent[b] = a;
+    else
+        _parent[a] = b;
+}
+
+// Join the runs of two adjacent rows that share at least one column.
+// Runs are sorted, so both rows are walked once side by side.
+void SegmentLabeller::joinRows(uint32_t above, uint32_t below)
+{
+    uint32_t a = _rowRuns[above], a_end = _rowRuns[above + 1];
+    uint32_t b = _rowRuns[below], b_end = _rowRuns[below + 1];
+
+    while (a < a_end && b < b_end)
+    {
+        if (_runStart[a] <= _runEnd[b] && _runStart[b] <= _runEnd[a])
+            join(a, b);
+
+        if (_runEnd[a] < _runEnd[b])
+            ++a;
+        else
+            ++b;
+    }
+}
+
+void SegmentLabeller::label(const CrustMap& map, uint32_t width,
+                            uint32_t height, Segments& segments,
+                            const TileOccupancy* tiles)
+{
+    ASSERT(segments.size() == 0, "Segments must be reset before labelling");
+    ASSERT(map.width() == width && map.height() == height,
+           "Map must have the size of the plate");
+
+    buildMask(map, width, height, tiles);
+    findRuns(width, height);
+
+    const uint32_t runs = (uint32_t)_runStart.size();
+    _parent.resize(runs);
+    for (uint32_t r = 0; r < runs; ++r)
+        _parent[r] = r;
+
+    for (uint32_t y = 1; y < height; ++y)
+        joinRows(y - 1, y);
+
+    // Allow wrapping around map edges.
+    if (height > 1 && height == _worldDimension.getHeight())
+        joinRows(height - 1, 0);
+
+    if (width == _worldDimension.getWidth())
+        for (uint32_t y = 0; y < height; ++y)
+        {
+            const uint32_t first = _rowRuns[y], last = _rowRuns[y + 1];
+            if (first < last && _runStart[first] == 0 &&
+                    _runEnd[last - 1] == width - 1)
+                join(first, last - 1);
+        }
+
+    // Second pass: give every continent an ID, write it to the points of
+    // its runs and measure the area and bounding box of each continent.
+    _runId.resize(runs);
+    std::vector<SegmentData> data;
+    ContinentIdMap& ids = segments.ids();
+
+    for (uint32_t y = 0; y < height; ++y)
+        for (uint32_t r = _rowRuns[y]; r < _rowRuns[y + 1]; ++r)
+        {
+            const uint32_t start = _runStart[r], end = _runEnd[r];
+            const uint32_t parent = root(r);
+
+            if (parent == r) {
+                if (data.size() >= MAX_CONTINENTS)
+                    throw std::runtime_error("Too many continents for ContinentId");
+                _runId[r] = (uint32_t)data.size();
+                Platec::Rectangle rect(_worldDimension, start, end, y, y);
+                data.push_back(SegmentData(rect, 0));
+            } else {
+                _runId[r] = _runId[parent];
+                SegmentData& seg = data[_runId[r]];
+                if (start < seg.getLeft()) seg.setLeft(start);
+                if (end > seg.getRight()) seg.setRight(end);
+                if (y < seg.getTop()) seg.setTop(y);
+                if (y > seg.getBottom()) seg.setBottom(y);
+            }
+
+            data[_runId[r]].incArea(1 + end - start);
+
+            for (uint32_t x = start; x <= end; ++x)
+                ids.set(x, y, (ContinentId)_runId[r]);
+        }
+
+    for (uint32_t i = 0; i < data.size(); ++i)
+        segments.add(data[i]);
+
+    remember(segments);
+}
+
+void SegmentLabeller::remember(const ISegments& segments)
+{
+    _areas.resize(segments.size());
+    for (uint32_t s = 0; s < _areas.size(); ++s)
+        _areas[s] = segments[s].area();
+
+    _dirty.clear();
+    _changed.clear();
+    _relabelAll = false;
+}
+
+void SegmentLabeller::markDirty(uint32_t x, uint32_t y)
+{
+    _dirty.push_back(x);
+    _dirty.push_back(y);
+}
+
+void SegmentLabeller::markChanged(ContinentId id)
+{
+    _changed.push_back(id);
+}
+
+void SegmentLabeller::shift(uint32_t d_lft, uint32_t d_top)
+{
+    for (uint32_t i = 0; i < _dirty.size(); i += 2) {
+        _dirty[i] += d_lft;
+        _dirty[i + 1] += d_top;
+    }
+}
+
+// Find the 4-ways adjacent points, wrapping around the plate edges the
+// same way label() does.
+uint32_t SegmentLabeller::neighbours(uint32_t index, uint32_t width,
+                                     uint32_t height, uint32_t* found) const
+{
+    const uint32_t x = index % width, y = index / width;
+    const bool wrap_x = width == _worldDimension.getWidth();
+    const bool wrap_y = height > 1 && height == _worldDimension.getHeight();
+    uint32_t n = 0;
+
+    if (x > 0) found[n++] = index - 1;
+    else if (wrap_x) found[n++] = index + width - 1;
+    if (x < width - 1) found[n++] = index + 1;
+    else if (wrap_x) found[n++] = index + 1 - width;
+    if (y > 0) found[n++] = index - width;
+    else if (wrap_y) found[n++] = index + (height - 1) * width;
+    if (y < height - 1) found[n++] = index + width;
+    else if (wrap_y) found[n++] = x;
+
+    return n;
+}
+
+// Take the label off every point of the continent.
+void SegmentLabeller::clear(Segments& segments, ContinentId id,
+                            uint32_t width, uint32_t height)
+{
+    const ISegmentData& data = segments[id];
+    const uint32_t bottom = data.getBottom() < height ? data.getBottom() : height - 1;
+    const uint32_t right = data.getRight() < width ? data.getRight() : width - 1;
+    ContinentIdMap& ids = segments.ids();
+
+    for (uint32_t y = data.getTop(); y <= bottom; ++y)
+        for (uint32_t x = data.getLeft(); x <= right; ++x)
+        {
+            if (ids.get(x, y) == id) {
+                ids.set(x, y, UNLABELLED);
+                _pending.push_back(y * width + x);
+            }
+        }
+}
+
+SegmentData SegmentLabeller::fill(const CrustMap& map, uint32_t width,
+                                  uint32_t height, ContinentIdMap& ids,
+                                  uint32_t origin, ContinentId id)
+{
+    Platec::Rectangle rect(_worldDimension, origin % width, origin % width,
+                           origin / width, origin / width);
+    SegmentData data(rect, 0);
+
+    ids[origin] = id;
+    _stack.push_back(origin);
+
+    while (!_stack.empty())
+    {
+        const uint32_t i = _stack.back();
+        const uint32_t x = i % width, y = i / width;
+        _stack.pop_back();
+
+        data.incArea();
+        if (x < data.getLeft()) data.setLeft(x);
+        if (x > data.getRight()) data.setRight(x);
+        if (y < data.getTop()) data.setTop(y);
+        if (y > data.getBottom()) data.setBottom(y);
+
+        uint32_t next[4];
+        const uint32_t n = neighbours(i, width, height, next);
+        for (uint32_t k = 0; k < n; ++k)
+            if (ids[next[k]] == UNLABELLED && map[next[k]] >= CONT_BASE) {
+                ids[next[k]] = id;
+                _stack.push_back(next[k]);
+            }
+    }
+
+    return data;
+}
+
+// A continent that kept all of its points, and has no dirty point on it
+// or next to it, is still a connected component of its own: nothing that
+// touches it changed. Everything else is cleared and filled again; these
+// fills can't leak into the kept continents as they are still labelled.
+void SegmentLabeller::update(const CrustMap& map, uint32_t width,
+                             uint32_t height, Segments& segments,
+                             const TileOccupancy* tiles)
+{
+    // Past some amount of change labelling everything is cheaper.
+    if (_relabelAll || _dirty.size() / 2 > width * height / 16) {
+        segments.reset();
+        label(map, width, height, segments, tiles);
+        return;
+    }
+
+    const uint32_t count = segments.size();
+    const ContinentIdMap& ids = segments.ids();
+
+    _affected.assign(count, 0);
+    for (uint32_t s = 0; s < count; ++s)
+        _affected[s] = s >= _areas.size() || segments[s].area() != _areas[s];
+    for (uint32_t c = 0; c < _changed.size(); ++c)
+        if (_changed[c] < count)
+            _affected[_changed[c]] = 1;
+
+    _pending.clear();
+    for (uint32_t d = 0; d < _dirty.size(); d += 2)
+    {
+        const uint32_t i = _dirty[d + 1] * width + _dirty[d];
+        uint32_t next[4];
+        const uint32_t n = neighbours(i, width, height, next);
+
+        if (ids[i] < count)
+            _affected[ids[i]] = 1;
+        for (uint32_t k = 0; k < n; ++k)
+            if (ids[next[k]] < count)
+                _affected[ids[next[k]]] = 1;
+
+        _pending.push_back(i);
+    }
+
+    // IDs of cleared and long gone continents are given out again, the
+    // lowest first.
+    _free.clear();
+    for (uint32_t s = count; s-- > 0;)
+    {
+        if (_affected[s])
+            clear(segments, s, width, height);
+        if (_affected[s] || segments[s].isEmpty())
+            _free.push_back(s);
+    }
+
+    for (uint32_t p = 0; p < _pending.size(); ++p)
+    {
+        const uint32_t i = _pending[p];
+        if (ids[i] != UNLABELLED) {
+            continue;
+        }
+        if (map[i] < CONT_BASE) {
+            continue;
+        }
+
+        if (_free.empty()) {
+            if (segments.size() >= MAX_CONTINENTS)
+                throw std::runtime_error("Too many continents for ContinentId");
+            segments.add(fill(map, width, height, segments.ids(), i,
+                              segments.size()));
+        } else {
+            const ContinentId id = _free.back();
+            _free.pop_back();
+            segments.replace(id, fill(map, width, height, segments.ids(),
+                                      i, id));
+        }
+    }
+
+    for (uint32_t f = 0; f < _free.size(); ++f)
+        segments[_free[f]].markNonExistent();
+
+    for (uint32_t s = 0; s < segments.size(); ++s)
+        segments[s].resetCollCount();
+
+    remember(segments);
+}
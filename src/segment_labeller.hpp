@@ -0,0 +1,136 @@
+/******************************************************************************
+ *  plate-tectonics, a plate tectonics simulation library
+ *  Copyright (C) 2012-2013 Lauri Viitanen
+ *  Copyright (C) 2014-2015 Federico Tomassetti, Bret Curtis
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, see http://www.gnu.org/licenses/
+ *****************************************************************************/
+
+#ifndef SEGMENT_LABELLER_HPP
+#define SEGMENT_LABELLER_HPP
+
+#include <vector>
+#include "utils.hpp"
+#include "heightmap.hpp"
+#include "plate_storage.hpp"
+
+class ISegments;
+class Segments;
+class SegmentData;
+class TileOccupancy;
+
+/// Labels all the continents of a plate in one go.
+///
+/// Continental points are packed into a bit mask, one row at a time, and
+/// every row is cut into runs of consecutive continental points. Runs that
+/// touch runs of the row above are joined into the same continent with a
+/// union-find, then every run is given the ID of its continent. The cost
+/// is linear in the plate area, however the continents are shaped.
+///
+/// Between steps most of the crust keeps its side of CONT_BASE, so labels
+/// are kept and only the continents near the points marked dirty are
+/// labelled again: the cost follows the amount of change instead.
+class SegmentLabeller
+{
+public:
+    SegmentLabeller(const WorldDimension& worldDimension);
+
+    /// Separate all continents of the map to their own partitions.
+    ///
+    /// Points with at least CONT_BASE crust that are 4-ways adjacent get
+    /// the same segment ID. Continents are numbered in the order they are
+    /// met scanning the map row by row and their area and bounding box
+    /// are added to the segments. Continents wrap around the plate edges
+    /// when the plate is as wide or as tall as the world.
+    ///
+    /// @param  map         Plate's height map.
+    /// @param  width       Width of the plate.
+    /// @param  height      Height of the plate.
+    /// @param  segments    Segments of the plate, expected to be empty.
+    /// @param  tiles       Occupied tiles of the map, if known. Empty tiles
+    ///                     are not scanned.
+    /// @throw  std::runtime_error if there are more continents than
+    ///         ContinentId can number.
+    void label(const CrustMap& map, uint32_t width, uint32_t height,
+               Segments& segments, const TileOccupancy* tiles = NULL);
+
+    /// Bring the labels up to date with the changes made since last time.
+    ///
+    /// Continents that were touched by a dirty point, or whose area was
+    /// changed by the lazy segment creator, are labelled again; the other
+    /// continents keep their IDs. Collision counts of all continents are
+    /// cleared. The outcome is the same partition label() would produce.
+    ///
+    /// @param  map         Plate's height map.
+    /// @param  width       Width of the plate.
+    /// @param  height      Height of the plate.
+    /// @param  segments    Segments labelled with label() or update().
+    /// @param  tiles       Occupied tiles of the map, if known.
+    /// @throw  std::runtime_error if there are more continents than
+    ///         ContinentId can number.
+    void update(const CrustMap& map, uint32_t width, uint32_t height,
+                Segments& segments, const TileOccupancy* tiles = NULL);
+
+    /// Point may have become continental or stopped being so, or it was
+    /// given the ID of another continent.
+    void markDirty(uint32_t x, uint32_t y);
+
+    /// Continent must be labelled again, e.g. it lost some of its points.
+    void markChanged(ContinentId id);
+
+    /// Label everything from scratch next time, e.g. after erosion.
+    void markAllDirty() {
+        _relabelAll = true;
+    }
+
+    /// Plate grew to the left and top: move the dirty points along.
+    void shift(uint32_t d_lft, uint32_t d_top);
+
+private:
+    void buildMask(const CrustMap& map, uint32_t width, uint32_t height,
+                   const TileOccupancy* tiles);
+    void findRuns(uint32_t width, uint32_t height);
+    void joinRows(uint32_t above, uint32_t below);
+    uint32_t root(uint32_t run);
+    void join(uint32_t a, uint32_t b);
+    uint32_t nextSet(const uint64_t* row, uint32_t from, uint32_t width) const;
+    uint32_t nextClear(const uint64_t* row, uint32_t from, uint32_t width) const;
+    uint32_t neighbours(uint32_t index, uint32_t width, uint32_t height,
+                        uint32_t* found) const;
+    void clear(Segments& segments, ContinentId id, uint32_t width,
+               uint32_t height);
+    SegmentData fill(const CrustMap& map, uint32_t width, uint32_t height,
+                     ContinentIdMap& ids, uint32_t origin, ContinentId id);
+    void remember(const ISegments& segments);
+
+    const WorldDimension _worldDimension;
+    uint32_t _words;                    ///< Mask words per row.
+    std::vector<uint64_t> _mask;        ///< One bit per continental point.
+    std::vector<uint32_t> _runStart;    ///< First point of each run.
+    std::vector<uint32_t> _runEnd;      ///< Last point of each run.
+    std::vector<uint32_t> _rowRuns;     ///< First run of each row, plus one past the last.
+    std::vector<uint32_t> _parent;      ///< Union-find forest of the runs.
+    std::vector<uint32_t> _runId;       ///< Continent of each run.
+
+    bool _relabelAll;                   ///< Skip update(), use label().
+    std::vector<uint32_t> _dirty;       ///< X, Y of each dirty point.
+    std::vector<ContinentId> _changed;  ///< Continents marked changed.
+    std::vector<uint32_t> _areas;       ///< Area of each continent when labelled.
+    std::vector<unsigned char> _affected; ///< Continents to be labelled again.
+    std::vector<uint32_t> _pending;     ///< Points whose label was cleared.
+    std::vector<ContinentId> _free;     ///< IDs that can be given out again.
+    std::vector<uint32_t> _stack;       ///< Points left to fill.
+};
+
+#endif
@@ -19,68 +19,57 @@
 
 #include "segments.hpp"
 
-Segments::Segments(uint32_t plate_area)
+// Points that belong to no continent hold the largest ContinentId, which
+// is also what the missing tiles of sparse plates read as.
+Segments::Segments(uint32_t width, uint32_t height)
+    : _ids(width, height, (ContinentId)-1)
 {
-    _area = plate_area;
-    segment = new uint32_t[plate_area];
-    memset(segment, 255, plate_area * sizeof(uint32_t));
-}
-
-Segments::~Segments()
-{
-    delete[] segment;
-    segment = NULL;
-    _area = 0;
-    for (int i=0; i<seg_data.size(); i++) {
-        delete seg_data[i];
-    }
 }
 
 uint32_t Segments::area()
 {
-    return _area;
+    return _ids.area();
 }
 
 void Segments::reset()
 {
-    memset(segment, -1, sizeof(uint32_t) * _area);
+    _ids.set_all((ContinentId)-1);
     seg_data.clear();
 }
 
-void Segments::reassign(uint32_t newarea, uint32_t* tmps)
+void Segments::grow(uint32_t old_width, uint32_t old_height,
+                    uint32_t new_width, uint32_t new_height,
+                    uint32_t d_lft, uint32_t d_top)
 {
-    delete[] segment;
-    _area = newarea;
-    segment = tmps;
+    ASSERT(old_width == _ids.width() && old_height == _ids.height(),
+           "Invalid old ID map size");
+    _ids.grow(new_width, new_height, d_lft, d_top, (ContinentId)-1);
+}
+
+void Segments::crop(uint32_t old_width, uint32_t x, uint32_t y,
+                    uint32_t width, uint32_t height)
+{
+    ASSERT(old_width == _ids.width(), "Invalid old ID map size");
+    _ids.crop(x, y, width, height);
 }
 
 void Segments::shift(uint32_t d_lft, uint32_t d_top)
 {
     for (uint32_t s = 0; s < seg_data.size(); ++s)
     {
-        seg_data[s]->shift(d_lft, d_top);
+        seg_data[s].shift(d_lft, d_top);
     }
 }
 
-uint32_t Segments::size() const
+void Segments::add(const SegmentData& data)
 {
-    return (uint32_t)seg_data.size();
-}
-
-const ISegmentData& Segments::operator[](uint32_t index) const
-{
-    ASSERT(index < seg_data.size(), "Invalid index");
-    return *seg_data[index];
+    seg_data.push_back(data);
 }
 
-ISegmentData& Segments::operator[](uint32_t index)
+void Segments::replace(uint32_t index, const SegmentData& data)
 {
     ASSERT(index < seg_data.size(), "Invalid index");
-    return *seg_data[index];
-}
-
-void Segments::add(ISegmentData* data) {
-    seg_data.push_back(data);
+    seg_data[index] = data;
 }
 
 ContinentId Segments::getContinentAt(int x, int y) const
@@ -24,6 +24,7 @@
 #include <cmath>     // sin, cos
 #include "simplerandom.hpp"
 #include "heightmap.hpp"
+#include "plate_storage.hpp"
 #include "rectangle.hpp"
 #include "segment_data.hpp"
 #include "utils.hpp"
@@ -32,32 +33,32 @@
 #include "mass.hpp"
 #include "segment_creator.hpp"
 
-typedef uint32_t ContinentId;
-
 class ISegments
 {
 public:
     virtual uint32_t area() = 0;
     virtual void reset() = 0;
-    virtual void reassign(uint32_t newarea, uint32_t* tmps) = 0;
+    virtual void grow(uint32_t old_width, uint32_t old_height,
+                      uint32_t new_width, uint32_t new_height,
+                      uint32_t d_lft, uint32_t d_top) = 0;
+    virtual void crop(uint32_t old_width, uint32_t x, uint32_t y,
+                      uint32_t width, uint32_t height) = 0;
     virtual void shift(uint32_t d_lft, uint32_t d_top) = 0;
     virtual uint32_t size() const = 0;
     virtual const ISegmentData& operator[](uint32_t index) const = 0;
     virtual ISegmentData& operator[](uint32_t index) = 0;
-    virtual void add(ISegmentData* data) = 0;
+    virtual void add(const SegmentData& data) = 0;
+    virtual void replace(uint32_t index, const SegmentData& data) = 0;
     // Continent at the give world index
     virtual const ContinentId& id(uint32_t index) const = 0;
-    // Continent at the give world index
-    virtual ContinentId& id(uint32_t index) = 0;
     virtual void setId(uint32_t index, ContinentId id) = 0;
     virtual ContinentId getContinentAt(int x, int y) const = 0;
 };
 
-class Segments : public ISegments
+class Segments PLATEC_FINAL : public ISegments
 {
 public:
-    Segments(uint32_t plate_area);
-    ~Segments();
+    Segments(uint32_t width, uint32_t height);
     void setSegmentCreator(ISegmentCreator* segmentCreator)
     {
         _segmentCreator = segmentCreator;
@@ -68,26 +69,44 @@ public:
     }
     uint32_t area();
     void reset();
-    void reassign(uint32_t newarea, uint32_t* tmps);
+    /// Enlarge the ID map keeping the old IDs at (d_lft, d_top).
+    void grow(uint32_t old_width, uint32_t old_height,
+              uint32_t new_width, uint32_t new_height,
+              uint32_t d_lft, uint32_t d_top);
+    /// Keep only the IDs of the width * height block at (x, y).
+    void crop(uint32_t old_width, uint32_t x, uint32_t y,
+              uint32_t width, uint32_t height);
     void shift(uint32_t d_lft, uint32_t d_top);
-    uint32_t size() const;
-    const ISegmentData& operator[](uint32_t index) const;
-    ISegmentData& operator[](uint32_t index);
-    void add(ISegmentData* data);
-    const ContinentId& id(uint32_t index) const {
-        return segment[index];
+    uint32_t size() const {
+        return (uint32_t)seg_data.size();
+    }
+    const SegmentData& operator[](uint32_t index) const {
+        ASSERT(index < seg_data.size(), "Invalid index");
+        return seg_data[index];
     }
-    ContinentId& id(uint32_t index) {
-        return segment[index];
+    SegmentData& operator[](uint32_t index) {
+        ASSERT(index < seg_data.size(), "Invalid index");
+        return seg_data[index];
+    }
+    void add(const SegmentData& data);
+    void replace(uint32_t index, const SegmentData& data);
+    const ContinentId& id(uint32_t index) const {
+        return _ids[index];
     }
     void setId(uint32_t index, ContinentId id) {
-        segment[index] = id;
+        _ids[index] = id;
+    }
+    /// Segment ID of every point of the plate.
+    const ContinentIdMap& ids() const {
+        return _ids;
+    }
+    ContinentIdMap& ids() {
+        return _ids;
     }
     ContinentId getContinentAt(int x, int y) const;
 private:
-    std::vector<ISegmentData*> seg_data; ///< Details of each crust segment.
-    ContinentId* segment;              ///< Segment ID of each piece of continental crust.
-    int _area; /// Should be the same as the bounds area of the plate
+    std::vector<SegmentData> seg_data; ///< Details of each crust segment.
+    ContinentIdMap _ids;               ///< Segment ID of each piece of continental crust.
     ISegmentCreator* _segmentCreator;
     IBounds* _bounds;
 };
@@ -30,24 +30,12 @@ uint32_t simplerandom_cong_next(SimpleRandomCong_t * p_cong);
 
 SimpleRandom::SimpleRandom(uint32_t seed)
 {
-    internal = new SimpleRandomCong_t();
-    simplerandom_cong_seed(internal, seed);
-}
-
-SimpleRandom::SimpleRandom(const SimpleRandom& other)
-{
-    internal = new SimpleRandomCong_t();
-    internal->cong = other.internal->cong;
-}
-
-SimpleRandom::~SimpleRandom()
-{
-    delete internal;
+    simplerandom_cong_seed(&internal, seed);
 }
 
 uint32_t SimpleRandom::next()
 {
-    uint32_t res = simplerandom_cong_next(internal);
+    uint32_t res = simplerandom_cong_next(&internal);
 
     return res;
 }
@@ -75,6 +63,98 @@ uint32_t SimpleRandom::maximum()
     return 4294967295;
 }
 
+// Multiplier and increment that advance the generator by n values at once.
+static void simplerandom_cong_power(uint64_t n, uint32_t* p_mul, uint32_t* p_inc)
+{
+    uint32_t mul = 1u, inc = 0u;
+    uint32_t step_mul = UINT32_C(69069), step_inc = 12345u;
+
+    while (n)
+    {
+        if (n & 1u)
+        {
+            mul *= step_mul;
+            inc = inc * step_mul + step_inc;
+        }
+        step_inc = (step_mul + 1u) * step_inc;
+        step_mul *= step_mul;
+        n >>= 1;
+    }
+    *p_mul = mul;
+    *p_inc = inc;
+}
+
+void SimpleRandom::jump(uint64_t n)
+{
+    uint32_t mul, inc;
+    simplerandom_cong_power(n, &mul, &inc);
+    internal.cong = mul * internal.cong + inc;
+}
+
+void SimpleRandom::fill_double(double* out, uint32_t n)
+{
+    const uint32_t LANES = 8;
+    const double max = (double)maximum();
+    uint32_t i = 0;
+
+    if (n >= LANES)
+    {
+        // Lane k yields values k, k + LANES, k + 2 * LANES...
+        uint32_t lane[LANES];
+        for (uint32_t k = 0; k < LANES; ++k)
+            lane[k] = simplerandom_cong_next(&internal);
+
+        uint32_t mul, inc;
+        simplerandom_cong_power(LANES, &mul, &inc);
+        for (; i + LANES <= n; i += LANES)
+        {
+            for (uint32_t k = 0; k < LANES; ++k)
+            {
+                out[i + k] = (double)lane[k] / max;
+                lane[k] = mul * lane[k] + inc;
+            }
+        }
+
+        // Lanes have run one round ahead of the values handed out. The
+        // period is 2^32, so jumping 2^32 - LANES values steps back.
+        internal.cong = lane[LANES - 1];
+        jump(UINT64_C(0x100000000) - LANES);
+    }
+
+    for (; i < n; ++i)
+        out[i] = next_double();
+}
+
+static uint64_t mix64(uint64_t z)
+{
+    z = (z ^ (z >> 30)) * UINT64_C(0xbf58476d1ce4e5b9);
+    z = (z ^ (z >> 27)) * UINT64_C(0x94d049bb133111eb);
+    return z ^ (z >> 31);
+}
+
+static const uint64_t GOLDEN_GAMMA = UINT64_C(0x9e3779b97f4a7c15);
+
+RandomStream::RandomStream(uint32_t seed, uint32_t stream, uint32_t step)
+{
+    _key = mix64((((uint64_t)seed << 32) | stream) ^ mix64(step + GOLDEN_GAMMA));
+}
+
+uint32_t RandomStream::at(uint32_t i) const
+{
+    return (uint32_t)(mix64(_key + (i + (uint64_t)1) * GOLDEN_GAMMA) >> 32);
+}
+
+double RandomStream::double_at(uint32_t i) const
+{
+    return (double)at(i) / 4294967295.0;
+}
+
+void RandomStream::fill_double(double* out, uint32_t first, uint32_t n) const
+{
+    for (uint32_t i = 0; i < n; ++i)
+        out[i] = double_at(first + i);
+}
+
 uint32_t simplerandom_cong_num_seeds(const SimpleRandomCong_t * p_cong)
 {
     (const void *)p_cong;   /* We only use this parameter for type checking. */
@@ -31,11 +31,12 @@ typedef struct
 } SimpleRandomCong_t;
 
 
+/// Linear congruential generator, the one every seed of the library has
+/// always been reproduced with. It is a plain value: copies are cheap and
+/// continue the sequence independently of the original.
 class SimpleRandom {
 public:
     SimpleRandom(uint32_t seed);
-    SimpleRandom(const SimpleRandom& other);
-    ~SimpleRandom();
     uint32_t next();
     int32_t next_signed();
     // Return a random value in [0.0, 1.0]
@@ -43,9 +44,41 @@ public:
     // Return a random value in [-0.5f, 0.5f]
     float next_float_signed();
     uint32_t maximum();
+
+    /// Skip the next n values in O(log n) steps.
+    void jump(uint64_t n);
+
+    /// Store the next n values of next_double() to out.
+    ///
+    /// The sequence is the same as calling next_double() n times, but the
+    /// values are generated on independent lanes the compiler can vectorize.
+    void fill_double(double* out, uint32_t n);
+private:
+    SimpleRandomCong_t internal;
+};
+
+/// Counter based generator.
+///
+/// Every value depends only on the stream's key and its position, so
+/// streams of different plates or steps are independent of each other and
+/// of the order they are read in. Meant for work split across threads.
+class RandomStream {
+public:
+    /// @param  seed    Seed of the whole simulation.
+    /// @param  stream  Independent stream, e.g. index of a plate.
+    /// @param  step    Iteration the values are used in.
+    RandomStream(uint32_t seed, uint32_t stream, uint32_t step);
+
+    /// Value at position i of the stream.
+    uint32_t at(uint32_t i) const;
+
+    /// Value at position i of the stream as a value in [0.0, 1.0].
+    double double_at(uint32_t i) const;
+
+    /// Store n values starting at position first to out as by double_at.
+    void fill_double(double* out, uint32_t first, uint32_t n) const;
 private:
-    SimpleRandomCong_t* internal;
-    int counter;
+    uint64_t _key;
 };
 
 #endif
@@ -0,0 +1,191 @@
+/******************************************************************************
+ *  plate-tectonics, a plate tectonics simulation library
+ *  Copyright (C) 2012-2013 Lauri Viitanen
+ *  Copyright (C) 2014-2015 Federico Tomassetti, Bret Curtis
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, see http://www.gnu.org/licenses/
+ *****************************************************************************/
+
+#include "tile_occupancy.hpp"
+
+TileOccupancy::TileOccupancy()
+    : _width(0), _height(0), _tilesX(0), _tilesY(0), _words(0)
+{
+}
+
+void TileOccupancy::resize(uint32_t width, uint32_t height)
+{
+    _width = width;
+    _height = height;
+    _tilesX = (width + TILE_SIZE - 1) >> TILE_SHIFT;
+    _tilesY = (height + TILE_SIZE - 1) >> TILE_SHIFT;
+    _words = (_tilesX + 63) / 64;
+}
+
+// Sparse plates' tiles are the same as these, a missing one is empty.
+bool TileOccupancy::measure(const CrustMap& map, uint32_t tx, uint32_t ty) const
+{
+    const uint32_t x0 = tx << TILE_SHIFT;
+    const uint32_t y0 = ty << TILE_SHIFT;
+    const uint32_t x1 = x0 + TILE_SIZE < _width ? x0 + TILE_SIZE : _width;
+    const uint32_t y1 = y0 + TILE_SIZE < _height ? y0 + TILE_SIZE : _height;
+
+    for (uint32_t y = y0; y < y1; ++y)
+    {
+        uint32_t end;
+        const Crust* line = mapRun(map, x0, y, end);
+        if (line == NULL)
+            return false;
+        for (uint32_t x = x0; x < x1; ++x)
+            if (line[x - x0] != 0)
+                return true;
+    }
+
+    return false;
+}
+
+void TileOccupancy::build(const CrustMap& map)
+{
+    resize(map.width(), map.height());
+    _bits.assign(_words * _tilesY, 0);
+
+    for (uint32_t ty = 0; ty < _tilesY; ++ty)
+        for (uint32_t tx = 0; tx < _tilesX; ++tx)
+            if (measure(map, tx, ty))
+                set(_bits, tx, ty);
+}
+
+void TileOccupancy::fill(uint32_t width, uint32_t height)
+{
+    resize(width, height);
+    _bits.assign(_words * _tilesY, 0);
+
+    for (uint32_t ty = 0; ty < _tilesY; ++ty)
+        for (uint32_t tx = 0; tx < _tilesX; ++tx)
+            set(_bits, tx, ty);
+}
+
+// First tile at or after tx that is occupied (or empty, if "wanted" is
+// false). Bits past the last tile are clear, so there's always an end.
+uint32_t TileOccupancy::nextTile(const uint64_t* row, uint32_t tx, bool wanted) const
+{
+    uint32_t w = tx >> 6;
+    if (w >= _words)
+        return _tilesX;
+
+    const uint64_t flip = wanted ? 0 : ~(uint64_t)0;
+    uint64_t bits = (row[w] ^ flip) & (~(uint64_t)0 << (tx & 63));
+    while (bits == 0) {
+        if (++w == _words)
+            return _tilesX;
+        bits = row[w] ^ flip;
+    }
+
+    const uint32_t found = w * 64 + Platec::lowestBit(bits);
+    return found < _tilesX ? found : _tilesX;
+}
+
+bool TileOccupancy::nextRun(uint32_t y, uint32_t from, uint32_t end,
+                            uint32_t& begin, uint32_t& finish) const
+{
+    if (from >= end)
+        return false;
+
+    const uint64_t* row = &_bits[(y >> TILE_SHIFT) * _words];
+    uint32_t tx = nextTile(row, from >> TILE_SHIFT, true);
+    begin = tx << TILE_SHIFT;
+    if (begin < from)
+        begin = from;
+    if (begin >= end)
+        return false;
+
+    tx = nextTile(row, tx, false);
+    finish = tx << TILE_SHIFT;
+    if (finish > end)
+        finish = end;
+    return true;
+}
+
+void TileOccupancy::grow(uint32_t width, uint32_t height,
+                         uint32_t d_lft, uint32_t d_top)
+{
+    const uint32_t old_width = _width, old_height = _height;
+    const uint32_t old_tiles_x = _tilesX, old_tiles_y = _tilesY;
+    const uint32_t old_words = _words;
+
+    resize(width, height);
+    _spare.assign(_words * _tilesY, 0);
+
+    // Every old tile lands on at most four new ones.
+    for (uint32_t oty = 0; oty < old_tiles_y; ++oty)
+        for (uint32_t otx = 0; otx < old_tiles_x; ++otx)
+        {
+            if (!((_bits[oty * old_words + (otx >> 6)] >> (otx & 63)) & 1))
+                continue;
+
+            const uint32_t x0 = (otx << TILE_SHIFT) + d_lft;
+            const uint32_t y0 = (oty << TILE_SHIFT) + d_top;
+            const uint32_t x1 = ((otx + 1) << TILE_SHIFT < old_width ?
+                                 (otx + 1) << TILE_SHIFT : old_width) - 1 + d_lft;
+            const uint32_t y1 = ((oty + 1) << TILE_SHIFT < old_height ?
+                                 (oty + 1) << TILE_SHIFT : old_height) - 1 + d_top;
+
+            for (uint32_t ty = y0 >> TILE_SHIFT; ty <= y1 >> TILE_SHIFT; ++ty)
+                for (uint32_t tx = x0 >> TILE_SHIFT; tx <= x1 >> TILE_SHIFT; ++tx)
+                    set(_spare, tx, ty);
+        }
+
+    _bits.swap(_spare);
+}
+
+void TileOccupancy::refresh(const CrustMap& map)
+{
+    ASSERT(map.width() == _width && map.height() == _height,
+           "Map must have the size of the tiles");
+    _spare.assign(_bits.size(), 0);
+
+    // Occupied tiles and their neighbours are the candidates.
+    for (uint32_t ty = 0; ty < _tilesY; ++ty)
+    {
+        const uint64_t* row = &_bits[ty * _words];
+        for (uint32_t tx = nextTile(row, 0, true); tx < _tilesX;
+                tx = nextTile(row, tx + 1, true))
+        {
+            set(_spare, tx, ty);
+            set(_spare, tx > 0 ? tx - 1 : _tilesX - 1, ty);
+            set(_spare, tx + 1 < _tilesX ? tx + 1 : 0, ty);
+            set(_spare, tx, ty > 0 ? ty - 1 : _tilesY - 1);
+            set(_spare, tx, ty + 1 < _tilesY ? ty + 1 : 0);
+        }
+    }
+
+    _bits.assign(_bits.size(), 0);
+    for (uint32_t ty = 0; ty < _tilesY; ++ty)
+    {
+        const uint64_t* row = &_spare[ty * _words];
+        for (uint32_t tx = nextTile(row, 0, true); tx < _tilesX;
+                tx = nextTile(row, tx + 1, true))
+            if (measure(map, tx, ty))
+                set(_bits, tx, ty);
+    }
+}
+
+uint32_t TileOccupancy::occupiedTiles() const
+{
+    uint32_t count = 0;
+    for (uint32_t w = 0; w < _bits.size(); ++w)
+        for (uint64_t bits = _bits[w]; bits != 0; bits &= bits - 1)
+            ++count;
+    return count;
+}
@@ -0,0 +1,116 @@
+/******************************************************************************
+ *  plate-tectonics, a plate tectonics simulation library
+ *  Copyright (C) 2012-2013 Lauri Viitanen
+ *  Copyright (C) 2014-2015 Federico Tomassetti, Bret Curtis
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, see http://www.gnu.org/licenses/
+ *****************************************************************************/
+
+#ifndef TILE_OCCUPANCY_HPP
+#define TILE_OCCUPANCY_HPP
+
+#include <vector>
+#include "utils.hpp"
+#include "plate_storage.hpp"
+
+/// Coarse map of the parts of a plate that hold crust.
+///
+/// The plate's map is cut in square tiles of TILE_SIZE points, one bit per
+/// tile. A clear bit guarantees every point of the tile is zero, so loops
+/// over the plate can skip the tile altogether. A set bit only means the
+/// tile may hold crust: removing crust leaves the bit alone until the map
+/// is measured again.
+///
+/// Plates that wrap or stretch across the world are mostly empty boxes;
+/// with the tiles their cost follows the crust instead of the box.
+class TileOccupancy
+{
+public:
+    /// Tiles are as wide as the words of SegmentLabeller's bit mask.
+    static const uint32_t TILE_SHIFT = 6;
+    static const uint32_t TILE_SIZE = 1 << TILE_SHIFT;
+
+    TileOccupancy();
+
+    /// Measure the whole map from scratch.
+    ///
+    /// @param  map     Plate's height map.
+    void build(const CrustMap& map);
+
+    /// Let every tile hold crust, e.g. on the world's map.
+    void fill(uint32_t width, uint32_t height);
+
+    /// Point may have received crust.
+    void mark(uint32_t x, uint32_t y) {
+        const uint32_t tx = x >> TILE_SHIFT;
+        _bits[(y >> TILE_SHIFT) * _words + (tx >> 6)] |= (uint64_t)1 << (tx & 63);
+    }
+
+    /// Same as mark(), for an index of the map.
+    void markIndex(uint32_t index) {
+        mark(index % _width, index / _width);
+    }
+
+    /// May the tile of the point hold crust?
+    bool occupied(uint32_t x, uint32_t y) const {
+        const uint32_t tx = x >> TILE_SHIFT;
+        return (_bits[(y >> TILE_SHIFT) * _words + (tx >> 6)] >> (tx & 63)) & 1;
+    }
+
+    /// Find the next run of columns of row y, at or after "from" and
+    /// before "end", whose tiles may hold crust.
+    ///
+    /// @param[out] begin   First column of the run.
+    /// @param[out] finish  One past the last column of the run.
+    /// @return             False if the rest of the row is empty.
+    bool nextRun(uint32_t y, uint32_t from, uint32_t end,
+                 uint32_t& begin, uint32_t& finish) const;
+
+    /// Map grew to the given size, the old points moved right by d_lft
+    /// and down by d_top: move the tiles along.
+    void grow(uint32_t width, uint32_t height, uint32_t d_lft, uint32_t d_top);
+
+    /// Measure again the occupied tiles and their four neighbours, wrapping
+    /// around the edges. Meant for erosion, which moves crust one point at
+    /// most, and clears the tiles that lost all their crust.
+    void refresh(const CrustMap& map);
+
+    uint32_t width() const {
+        return _width;
+    }
+    uint32_t height() const {
+        return _height;
+    }
+
+    /// Number of tiles that may hold crust.
+    uint32_t occupiedTiles() const;
+
+private:
+    void set(std::vector<uint64_t>& bits, uint32_t tx, uint32_t ty) const {
+        bits[ty * _words + (tx >> 6)] |= (uint64_t)1 << (tx & 63);
+    }
+    void resize(uint32_t width, uint32_t height);
+    bool measure(const CrustMap& map, uint32_t tx, uint32_t ty) const;
+    uint32_t nextTile(const uint64_t* row, uint32_t tx, bool wanted) const;
+
+    uint32_t _width;               ///< Width of the map in points.
+    uint32_t _height;              ///< Height of the map in points.
+    uint32_t _tilesX;              ///< Tiles per row of the map.
+    uint32_t _tilesY;              ///< Rows of tiles.
+    uint32_t _words;               ///< Bit words per row of tiles.
+    std::vector<uint64_t> _bits;   ///< One bit per tile, set if occupied.
+    std::vector<uint64_t> _spare;  ///< Bits being rebuilt by grow and refresh.
+};
+
+#endif
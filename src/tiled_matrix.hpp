@@ -0,0 +1,489 @@
+/******************************************************************************
+ *  plate-tectonics, a plate tectonics simulation library
+ *  Copyright (C) 2012-2013 Lauri Viitanen
+ *  Copyright (C) 2014-2015 Federico Tomassetti, Bret Curtis
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, see http://www.gnu.org/licenses/
+ *****************************************************************************/
+
+#ifndef TILED_MATRIX_HPP
+#define TILED_MATRIX_HPP
+
+#include <algorithm> // std::fill, std::swap
+#include <cstring>
+#include <vector>
+#include "utils.hpp"
+#include "heightmap.hpp"
+
+/// Type the values of a TiledMatrix are read as through its writable
+/// points. Value types that only convert to arithmetic types themselves,
+/// such as compact plates' Crust, specialize it.
+template <typename Value>
+struct TiledRead
+{
+    typedef Value type;
+};
+
+/// Matrix of plain values kept in square tiles, a tile being allocated only
+/// once it holds something else than the fill value of the matrix.
+///
+/// Tiles are TILE_SIZE points wide and anchored at the top left corner of
+/// the matrix, like the ones of TileOccupancy. A missing tile reads as the
+/// fill value, so the storage follows the points in use instead of the
+/// bounding box of the matrix. Points of the edge tiles that lie past the
+/// matrix always hold the fill value.
+///
+/// Reading never allocates. Writing anything but the fill value to a
+/// missing tile allocates it, which must not happen on two threads at once:
+/// concurrent writers reserve() their tiles beforehand.
+///
+/// Values are copied and compared bytewise, so Value must be trivially
+/// copyable.
+template <typename Value>
+class TiledMatrix
+{
+public:
+    static const uint32_t TILE_SHIFT = 6;
+    static const uint32_t TILE_SIZE = 1 << TILE_SHIFT;
+    static const uint32_t TILE_AREA = TILE_SIZE * TILE_SIZE;
+
+    typedef typename TiledRead<Value>::type Read;
+
+    /// Writable point of the matrix, as given by the non-const operator[].
+    class Ref
+    {
+    public:
+        Ref(TiledMatrix& matrix, uint32_t x, uint32_t y)
+            : _matrix(matrix), _x(x), _y(y) {}
+
+        operator Read() const {
+            return _matrix.get(_x, _y);
+        }
+        Ref& operator=(const Value& value) {
+            _matrix.set(_x, _y, value);
+            return *this;
+        }
+        Ref& operator=(const Ref& other) {
+            _matrix.set(_x, _y, other._matrix.get(other._x, other._y));
+            return *this;
+        }
+        Ref& operator+=(Read delta) {
+            Value value = _matrix.get(_x, _y);
+            value += delta;
+            _matrix.set(_x, _y, value);
+            return *this;
+        }
+        Ref& operator-=(Read delta) {
+            Value value = _matrix.get(_x, _y);
+            value -= delta;
+            _matrix.set(_x, _y, value);
+            return *this;
+        }
+
+    private:
+        TiledMatrix& _matrix;
+        uint32_t _x;
+        uint32_t _y;
+    };
+
+    TiledMatrix(uint32_t width, uint32_t height, const Value& fill = Value(0))
+        : _fill(fill)
+    {
+        ASSERT(width != 0 && height != 0, "Matrix width and height should be greater than zero");
+        resize(width, height);
+    }
+
+    TiledMatrix(const TiledMatrix<Value>& other)
+        : _fill(other._fill)
+    {
+        resize(other._width, other._height);
+        copyTiles(other);
+    }
+
+    ~TiledMatrix()
+    {
+        release();
+    }
+
+    TiledMatrix<Value>& operator=(const TiledMatrix<Value>& other)
+    {
+        if (this != &other)
+            copy(other);
+        return *this;
+    }
+
+    void copy(const TiledMatrix& other)
+    {
+        release();
+        _fill = other._fill;
+        resize(other._width, other._height);
+        copyTiles(other);
+    }
+
+    /// Exchange contents and storage with the other matrix.
+    void swap(TiledMatrix& other)
+    {
+        _tiles.swap(other._tiles);
+        std::swap(_fill, other._fill);
+        std::swap(_width, other._width);
+        std::swap(_height, other._height);
+        std::swap(_tilesX, other._tilesX);
+        std::swap(_tilesY, other._tilesY);
+    }
+
+    /// Setting the fill value gives all tiles back.
+    void set_all(const Value& value)
+    {
+        release();
+        if (same(value, _fill))
+            return;
+        for (uint32_t y = 0; y < _height; ++y)
+            for (uint32_t x = 0; x < _width; ++x)
+                set(x, y, value);
+    }
+
+    /// Enlarge the matrix keeping its contents at (d_lft, d_top). Only the
+    /// tiles that receive something else than the fill value are allocated.
+    void grow(uint32_t width, uint32_t height,
+              uint32_t d_lft, uint32_t d_top, const Value& fill)
+    {
+        ASSERT(same(fill, _fill), "Matrix grows with its own fill value");
+        ASSERT(_width + d_lft <= width && _height + d_top <= height,
+               "Matrix does not fit its new size");
+        recut(width, height, 0, 0, d_lft, d_top, _width, _height);
+    }
+
+    /// Keep only the width * height values with top left corner at (x, y).
+    void crop(uint32_t x, uint32_t y, uint32_t width, uint32_t height)
+    {
+        ASSERT(width != 0 && height != 0 &&
+               x + width <= _width && y + height <= _height,
+               "Crop must be inside the matrix");
+        recut(width, height, x, y, 0, 0, width, height);
+    }
+
+    /// Store a row-major array of width * height values in the matrix.
+    /// Tiles left with only the fill value are given back.
+    template <typename Source>
+    void assign(const Source* values)
+    {
+        for (uint32_t ty = 0; ty < _tilesY; ++ty)
+            for (uint32_t tx = 0; tx < _tilesX; ++tx)
+            {
+                Value*& tile = _tiles[ty * _tilesX + tx];
+                const uint32_t x0 = tx << TILE_SHIFT, x1 = columnEnd(tx);
+                const uint32_t y0 = ty << TILE_SHIFT, y1 = rowEnd(ty);
+                bool empty = true;
+
+                for (uint32_t y = y0; y < y1; ++y)
+                    for (uint32_t x = x0; x < x1; ++x)
+                    {
+                        const Value value = Value(values[y * _width + x]);
+                        const bool filler = same(value, _fill);
+                        if (tile == NULL) {
+                            if (filler)
+                                continue;
+                            tile = allocateTile();
+                        }
+                        tile[offset(x, y)] = value;
+                        empty &= filler;
+                    }
+
+                if (tile != NULL && empty) {
+                    Platec::alignedFree(tile);
+                    tile = NULL;
+                }
+            }
+    }
+
+    /// Copy the matrix into a row-major array of width * height values.
+    template <typename Dest>
+    void copyTo(Dest* values) const
+    {
+        for (uint32_t y = 0; y < _height; ++y)
+        {
+            Dest* row = &values[y * _width];
+            for (uint32_t x = 0, end; x < _width; x = end)
+            {
+                const Value* tile = run(x, y, end);
+                for (uint32_t i = x; i < end; ++i)
+                    row[i] = (Dest)(tile != NULL ? tile[i - x] : _fill);
+            }
+        }
+    }
+
+    inline const Value& set(uint32_t x, uint32_t y, const Value& value)
+    {
+        ASSERT(x < _width && y < _height, "Invalid coordinates");
+        Value*& tile = _tiles[tileIndex(x, y)];
+        if (tile == NULL) {
+            if (same(value, _fill))
+                return value;
+            tile = allocateTile();
+        }
+        tile[offset(x, y)] = value;
+        return value;
+    }
+
+    inline const Value& get(uint32_t x, uint32_t y) const
+    {
+        ASSERT(x < _width && y < _height, "Invalid coordinates");
+        const Value* tile = _tiles[tileIndex(x, y)];
+        return tile != NULL ? tile[offset(x, y)] : _fill;
+    }
+
+    Ref operator[](uint32_t index)
+    {
+        const uint32_t y = index / _width;
+        return Ref(*this, index - y * _width, y);
+    }
+
+    const Value& operator[](uint32_t index) const
+    {
+        const uint32_t y = index / _width;
+        return get(index - y * _width, y);
+    }
+
+    /// Values of row y from column x on, up to column "end", which is set
+    /// to the end of the tile of (x, y) or of the row if that comes first.
+    /// NULL if the tile is missing: the values are all the fill value.
+    const Value* run(uint32_t x, uint32_t y, uint32_t& end) const
+    {
+        ASSERT(x < _width && y < _height, "Invalid coordinates");
+        end = columnEnd(x >> TILE_SHIFT);
+        const Value* tile = _tiles[tileIndex(x, y)];
+        return tile != NULL ? &tile[offset(x, y)] : NULL;
+    }
+
+    /// Allocate the tile of point (x, y), if missing.
+    void reserve(uint32_t x, uint32_t y)
+    {
+        ASSERT(x < _width && y < _height, "Invalid coordinates");
+        Value*& tile = _tiles[tileIndex(x, y)];
+        if (tile == NULL)
+            tile = allocateTile();
+    }
+
+    /// Allocate every tile the other matrix, of the same size, has.
+    template <typename Other>
+    void reserveLike(const TiledMatrix<Other>& other)
+    {
+        ASSERT(other.width() == _width && other.height() == _height,
+               "Matrices must be of the same size");
+        for (uint32_t ty = 0; ty < _tilesY; ++ty)
+            for (uint32_t tx = 0; tx < _tilesX; ++tx)
+            {
+                Value*& tile = _tiles[ty * _tilesX + tx];
+                if (tile == NULL && other.hasTile(tx, ty))
+                    tile = allocateTile();
+            }
+    }
+
+    /// Is tile (tx, ty) allocated?
+    bool hasTile(uint32_t tx, uint32_t ty) const
+    {
+        return _tiles[ty * _tilesX + tx] != NULL;
+    }
+
+    /// Number of tiles allocated.
+    uint32_t allocatedTiles() const
+    {
+        uint32_t count = 0;
+        for (uint32_t i = 0; i < _tiles.size(); ++i)
+            count += _tiles[i] != NULL;
+        return count;
+    }
+
+    const Value& fillValue() const
+    {
+        return _fill;
+    }
+    uint32_t width() const
+    {
+        return _width;
+    }
+    uint32_t height() const
+    {
+        return _height;
+    }
+    inline uint32_t area() const
+    {
+        return _width * _height;
+    }
+private:
+
+    static bool same(const Value& a, const Value& b)
+    {
+        return memcmp(&a, &b, sizeof(Value)) == 0;
+    }
+
+    static uint32_t offset(uint32_t x, uint32_t y)
+    {
+        return ((y & (TILE_SIZE - 1)) << TILE_SHIFT) | (x & (TILE_SIZE - 1));
+    }
+
+    uint32_t tileIndex(uint32_t x, uint32_t y) const
+    {
+        return (y >> TILE_SHIFT) * _tilesX + (x >> TILE_SHIFT);
+    }
+
+    /// One past the last column of the tiles of column tx.
+    uint32_t columnEnd(uint32_t tx) const
+    {
+        const uint32_t end = (tx + 1) << TILE_SHIFT;
+        return end < _width ? end : _width;
+    }
+
+    /// One past the last row of the tiles of row ty.
+    uint32_t rowEnd(uint32_t ty) const
+    {
+        const uint32_t end = (ty + 1) << TILE_SHIFT;
+        return end < _height ? end : _height;
+    }
+
+    void resize(uint32_t width, uint32_t height)
+    {
+        _width = width;
+        _height = height;
+        _tilesX = (width + TILE_SIZE - 1) >> TILE_SHIFT;
+        _tilesY = (height + TILE_SIZE - 1) >> TILE_SHIFT;
+        _tiles.assign(_tilesX * _tilesY, (Value*)NULL);
+    }
+
+    Value* allocateTile() const
+    {
+        Value* tile = static_cast<Value*>(Platec::alignedAlloc(TILE_AREA * sizeof(Value)));
+        std::fill(tile, tile + TILE_AREA, _fill);
+        return tile;
+    }
+
+    void copyTiles(const TiledMatrix& other)
+    {
+        for (uint32_t i = 0; i < _tiles.size(); ++i)
+            if (other._tiles[i] != NULL) {
+                _tiles[i] = static_cast<Value*>(Platec::alignedAlloc(TILE_AREA * sizeof(Value)));
+                memcpy(_tiles[i], other._tiles[i], TILE_AREA * sizeof(Value));
+            }
+    }
+
+    static void releaseTiles(std::vector<Value*>& tiles)
+    {
+        for (uint32_t i = 0; i < tiles.size(); ++i)
+            if (tiles[i] != NULL) {
+                Platec::alignedFree(tiles[i]);
+                tiles[i] = NULL;
+            }
+    }
+
+    void release()
+    {
+        releaseTiles(_tiles);
+    }
+
+    /// Cut the matrix to width * height values, the block of copy_width *
+    /// copy_height values at (src_x, src_y) moving to (dst_x, dst_y) and
+    /// the rest being the fill value. Fill values at the ends of the rows
+    /// of the old tiles are not copied, so they allocate nothing.
+    void recut(uint32_t width, uint32_t height, uint32_t src_x, uint32_t src_y,
+               uint32_t dst_x, uint32_t dst_y,
+               uint32_t copy_width, uint32_t copy_height)
+    {
+        const uint32_t tiles_x = (width + TILE_SIZE - 1) >> TILE_SHIFT;
+        const uint32_t tiles_y = (height + TILE_SIZE - 1) >> TILE_SHIFT;
+        std::vector<Value*> tiles(tiles_x * tiles_y, (Value*)NULL);
+
+        try {
+            for (uint32_t ty = 0; ty < _tilesY; ++ty)
+                for (uint32_t tx = 0; tx < _tilesX; ++tx)
+                {
+                    const Value* tile = _tiles[ty * _tilesX + tx];
+                    if (tile == NULL)
+                        continue;
+
+                    // Part of the tile inside the copied block.
+                    const uint32_t x0 = std::max(tx << TILE_SHIFT, src_x);
+                    const uint32_t x1 = std::min(columnEnd(tx), src_x + copy_width);
+                    const uint32_t y0 = std::max(ty << TILE_SHIFT, src_y);
+                    const uint32_t y1 = std::min(rowEnd(ty), src_y + copy_height);
+
+                    for (uint32_t y = y0; y < y1 && x0 < x1; ++y)
+                    {
+                        // Copy only the span between the first and the
+                        // last values that are not the fill value.
+                        const Value* row = &tile[offset(x0, y)];
+                        uint32_t first = 0, last = x1 - x0;
+                        while (first < last && same(row[first], _fill))
+                            ++first;
+                        while (last > first && same(row[last - 1], _fill))
+                            --last;
+                        if (first == last)
+                            continue;
+
+                        // The span lands on at most two tiles.
+                        const Value* values = &row[first];
+                        const uint32_t count = last - first;
+                        const uint32_t ny = y - src_y + dst_y;
+                        uint32_t nx = x0 + first - src_x + dst_x;
+                        for (uint32_t done = 0; done < count;)
+                        {
+                            const uint32_t room = TILE_SIZE - (nx & (TILE_SIZE - 1));
+                            const uint32_t n = count - done < room ? count - done : room;
+                            Value*& dst = tiles[(ny >> TILE_SHIFT) * tiles_x + (nx >> TILE_SHIFT)];
+                            if (dst == NULL)
+                                dst = allocateTile();
+                            memcpy(&dst[offset(nx, ny)], &values[done], n * sizeof(Value));
+                            done += n;
+                            nx += n;
+                        }
+                    }
+                }
+        } catch (...) {
+            releaseTiles(tiles);
+            throw;
+        }
+
+        release();
+        _tiles.swap(tiles);
+        _width = width;
+        _height = height;
+        _tilesX = tiles_x;
+        _tilesY = tiles_y;
+    }
+
+    std::vector<Value*> _tiles; ///< Tiles row by row, NULL if missing.
+    Value _fill;                ///< Value of the points of missing tiles.
+    uint32_t _width;
+    uint32_t _height;
+    uint32_t _tilesX;           ///< Tiles per row of the matrix.
+    uint32_t _tilesY;           ///< Rows of tiles.
+};
+
+/// Read-only handle on a TiledMatrix that is indexed like a pointer to the
+/// values of a Matrix. Valid as long as the matrix exists.
+template <typename Value>
+class TiledView
+{
+public:
+    TiledView() : _matrix(NULL) {}
+    TiledView(const TiledMatrix<Value>& matrix) : _matrix(&matrix) {}
+
+    const Value& operator[](uint32_t index) const
+    {
+        return (*_matrix)[index];
+    }
+private:
+    const TiledMatrix<Value>* _matrix;
+};
+
+#endif
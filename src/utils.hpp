@@ -26,8 +26,14 @@
 
 #if _WIN32 || _WIN64
 #include <Windows.h>
+typedef UINT8 uint8_t;
+typedef UINT16 uint16_t;
 typedef UINT32 uint32_t;
 typedef INT32 int32_t;
+typedef UINT64 uint64_t;
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
 #else
 #define __STDC_CONSTANT_MACROS
 #include <stdint.h>
@@ -37,11 +43,41 @@ typedef INT32 int32_t;
 #define UINT32_C(val) val##ui32
 #endif
 
+#ifndef UINT64_C
+#define UINT64_C(val) val##ui64
+#endif
+
+// Implementations that the inner loops use through their own type are
+// marked final, so the compiler may call and inline them directly.
+#if __cplusplus >= 201103L || (defined(_MSC_VER) && _MSC_VER >= 1700)
+#define PLATEC_FINAL final
+#else
+#define PLATEC_FINAL
+#endif
+
 namespace Platec {
 
 std::string to_string(uint32_t value);
 std::string to_string_f(float value);
 
+/// Position of the lowest set bit of a non-zero value.
+inline uint32_t lowestBit(uint64_t value)
+{
+#if defined(_MSC_VER) && defined(_WIN64)
+    unsigned long index;
+    _BitScanForward64(&index, value);
+    return index;
+#elif defined(_MSC_VER)
+    unsigned long index;
+    if (_BitScanForward(&index, (unsigned long)value))
+        return index;
+    _BitScanForward(&index, (unsigned long)(value >> 32));
+    return index + 32;
+#else
+    return __builtin_ctzll(value);
+#endif
+}
+
 }
 
 // MK: I strongly feel that a release build should have this disabled,
@@ -0,0 +1,81 @@
+/******************************************************************************
+ *  plate-tectonics, a plate tectonics simulation library
+ *  Copyright (C) 2012-2013 Lauri Viitanen
+ *  Copyright (C) 2014-2015 Federico Tomassetti, Bret Curtis
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, see http://www.gnu.org/licenses/
+ *****************************************************************************/
+
+#ifndef WORLD_STORAGE_HPP
+#define WORLD_STORAGE_HPP
+
+#include "utils.hpp"
+#include "heightmap.hpp"
+
+// Types of the plate index and age maps the lithosphere keeps for the
+// whole world.
+//
+// By default both hold uint32_t values. PLATEC_WORLD_INDEX_BITS (cmake
+// option WORLD_INDEX_BITS) set to 8 or 16 narrows the plate index map,
+// which then limits the number of plates. PLATEC_COMPACT_WORLD_AGES (cmake
+// option WITH_COMPACT_WORLD_AGES) keeps ages in 16 bits. Unlike the compact
+// plates, neither changes the outcome of the simulation: the values always
+// fit. The maps handed out by lithosphere are widened to uint32_t when
+// asked for.
+
+#if PLATEC_WORLD_INDEX_BITS == 8
+typedef uint8_t PlateIndex;
+#elif PLATEC_WORLD_INDEX_BITS == 16
+typedef uint16_t PlateIndex;
+#else
+typedef uint32_t PlateIndex;
+#endif
+
+#ifdef PLATEC_COMPACT_WORLD_AGES
+/// Creation time of the crust. The iteration count is a few hundred at
+/// most: it starts over with every cycle, and a cycle lasts no more than
+/// RESTART_ITERATIONS steps.
+typedef uint16_t WorldAge;
+#else
+typedef uint32_t WorldAge;
+#endif
+
+typedef Matrix<PlateIndex> PlateIndexMap;
+typedef Matrix<WorldAge> WorldAgeMap;
+
+/// Plate index of the points no plate has reached.
+static const PlateIndex NO_PLATE = (PlateIndex)-1;
+
+/// The values of a world map as uint32_t: the map's own storage when it
+/// holds uint32_t already.
+inline uint32_t* widenedMap(const Matrix<uint32_t>& map, Matrix<uint32_t>& view)
+{
+    return map.raw_data();
+}
+
+/// Otherwise "view" is filled with the widened values, NO_PLATE and the
+/// like widening to 0xFFFFFFFF.
+template <typename Value>
+uint32_t* widenedMap(const Matrix<Value>& map, Matrix<uint32_t>& view)
+{
+    if (view.width() != map.width() || view.height() != map.height())
+        Matrix<uint32_t>(map.width(), map.height()).swap(view);
+
+    const Value none = (Value)-1;
+    for (uint32_t i = 0; i < map.area(); ++i)
+        view[i] = map[i] != none ? map[i] : 0xFFFFFFFF;
+    return view.raw_data();
+}
+
+#endif
@@ -0,0 +1,101 @@
+/******************************************************************************
+ *  plate-tectonics, a plate tectonics simulation library
+ *  Copyright (C) 2012-2013 Lauri Viitanen
+ *  Copyright (C) 2014-2015 Federico Tomassetti, Bret Curtis
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, see http://www.gnu.org/licenses/
+ *****************************************************************************/
+
+#include <algorithm>
+#include "young_crust.hpp"
+
+using namespace std;
+
+static const vector<uint32_t> NO_POINTS;
+
+YoungCrust::YoungCrust() : _oldest(1)
+{
+}
+
+const vector<uint32_t>& YoungCrust::points(uint32_t t) const
+{
+    return t >= _oldest && t < _ages.size() ? _ages[t] : NO_POINTS;
+}
+
+void YoungCrust::forget(uint32_t t)
+{
+    for (uint32_t a = _oldest; a < t && a < _ages.size(); ++a)
+        vector<uint32_t>().swap(_ages[a]);
+    _oldest = max(_oldest, t);
+}
+
+// Missing tiles of sparse plates are of age 0, which is not listed.
+void YoungCrust::build(const CrustAgeMap& ages, uint32_t oldest)
+{
+    _ages.clear();
+    _oldest = max(oldest, (uint32_t)1);
+    const uint32_t width = ages.width();
+    for (uint32_t y = 0; y < ages.height(); ++y)
+        for (uint32_t x = 0, end; x < width; x = end)
+        {
+            const CrustAge* run = mapRun(ages, x, y, end);
+            if (run == NULL)
+                continue;
+            for (uint32_t i = x; i < end; ++i)
+                add(y * width + i, run[i - x]);
+        }
+}
+
+void YoungCrust::grow(uint32_t old_width, uint32_t width,
+                      uint32_t d_lft, uint32_t d_top)
+{
+    for (uint32_t a = _oldest; a < _ages.size(); ++a)
+    {
+        vector<uint32_t>& points = _ages[a];
+        for (uint32_t n = 0; n < points.size(); ++n)
+        {
+            const uint32_t x = points[n] % old_width + d_lft;
+            const uint32_t y = points[n] / old_width + d_top;
+            points[n] = y * width + x;
+        }
+    }
+}
+
+void YoungCrust::crop(uint32_t old_width, uint32_t lft, uint32_t top,
+                      uint32_t width, uint32_t height)
+{
+    for (uint32_t a = _oldest; a < _ages.size(); ++a)
+    {
+        vector<uint32_t>& points = _ages[a];
+        uint32_t kept = 0;
+        for (uint32_t n = 0; n < points.size(); ++n)
+        {
+            // Points left or above the rectangle wrap around to large
+            // values, so a single comparison rejects them.
+            const uint32_t x = points[n] % old_width - lft;
+            const uint32_t y = points[n] / old_width - top;
+            if (x < width && y < height)
+                points[kept++] = y * width + x;
+        }
+        points.resize(kept);
+    }
+}
+
+uint32_t YoungCrust::size() const
+{
+    uint32_t count = 0;
+    for (uint32_t a = _oldest; a < _ages.size(); ++a)
+        count += _ages[a].size();
+    return count;
+}
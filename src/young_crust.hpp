@@ -0,0 +1,82 @@
+/******************************************************************************
+ *  plate-tectonics, a plate tectonics simulation library
+ *  Copyright (C) 2012-2013 Lauri Viitanen
+ *  Copyright (C) 2014-2015 Federico Tomassetti, Bret Curtis
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, see http://www.gnu.org/licenses/
+ *****************************************************************************/
+
+#ifndef YOUNG_CRUST_HPP
+#define YOUNG_CRUST_HPP
+
+#include <vector>
+#include "utils.hpp"
+#include "plate_storage.hpp"
+
+/// Points of a plate's map that were given crust recently, by age.
+///
+/// Young crust gets a buoyancy bonus from the lithosphere. Instead of
+/// checking the age of every point of the world each step, it asks the
+/// plates for the points of the few ages that still get one.
+///
+/// Every point whose age is not older than the forgotten ones is listed
+/// under that age. A point is listed again whenever its age changes, so a
+/// list may also hold points that have aged or lost their crust since:
+/// users check the age map. Age 0 belongs to points that never had crust
+/// and is not listed.
+class YoungCrust
+{
+public:
+    YoungCrust();
+
+    /// Point "index" was given crust of age "t".
+    void add(uint32_t index, uint32_t t) {
+        if (t < _oldest)
+            return;
+        if (t >= _ages.size())
+            _ages.resize(t + 1);
+        _ages[t].push_back(index);
+    }
+
+    /// Points listed under age "t".
+    const std::vector<uint32_t>& points(uint32_t t) const;
+
+    /// Drop the ages older than "t", they won't be asked for anymore.
+    void forget(uint32_t t);
+
+    /// List again every point of the age map, forgetting the ages older
+    /// than "oldest". Later ages than the current one are listed too.
+    ///
+    /// @param  ages    Plate's age map.
+    /// @param  oldest  Oldest age to keep.
+    void build(const CrustAgeMap& ages, uint32_t oldest);
+
+    /// Map grew from "old_width" points per row to "width", the old points
+    /// moved right by d_lft and down by d_top: move the points along.
+    void grow(uint32_t old_width, uint32_t width, uint32_t d_lft, uint32_t d_top);
+
+    /// Map was cropped to the given rectangle: move the points inside it
+    /// and drop the others.
+    void crop(uint32_t old_width, uint32_t lft, uint32_t top,
+              uint32_t width, uint32_t height);
+
+    /// Number of points listed.
+    uint32_t size() const;
+
+private:
+    uint32_t _oldest;                           ///< Oldest age still listed.
+    std::vector<std::vector<uint32_t> > _ages;  ///< Points of each age.
+};
+
+#endif
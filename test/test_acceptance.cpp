@@ -18,6 +18,8 @@
  *****************************************************************************/
 
 #include "platecapi.hpp"
+#include "lithosphere.hpp"
+#include "plate.hpp"
 #include "gtest/gtest.h"
 #include <cstdlib>
 
@@ -26,32 +28,39 @@
 /// (the original library). We want to refactor the code while
 /// obtaining the same results.
 ///
+/// Continents are now labelled for all plates before the overlay instead
+/// of at their first collision, which changes the outcome of every
+/// simulation: the expected values below are those of this library since
+/// then. Compact plates round their crust and get other results.
+///
 /// Unfortunately they are still platform dependant.
 /// They work on Linux (and especially on the Travis servers).
 /// In the future we will work on having the same results on all
 /// the platforms, for now are used as guards against undesired changes.
 ///
 
-/*TEST(PlatecCreate, SameResultAsPlatec)
+TEST(PlatecCreate, SameResultAsPinned)
 {
   long seed = 3;
   void* p = platec_api_create(seed, 512, 512, 0.65,60,0.02,1000000,0.33,2,10);
   const float* heightmap = platec_api_get_heightmap(p);
 
-  EXPECT_FLOAT_EQ(0.1,  heightmap[0]);
-  EXPECT_FLOAT_EQ(1.483476f,  heightmap[100]);
+  EXPECT_FLOAT_EQ(0.1f, heightmap[0]);
+  EXPECT_FLOAT_EQ(0.1f, heightmap[100]);
   EXPECT_FLOAT_EQ(0.1f, heightmap[200]);
-  EXPECT_FLOAT_EQ(1.5217931f,   heightmap[1000]);
-  EXPECT_FLOAT_EQ(0.1f,  heightmap[5000]);
-  EXPECT_FLOAT_EQ(1.4538962f, heightmap[50000]);
-  EXPECT_FLOAT_EQ(1.5340517f, heightmap[100000]);
+  EXPECT_FLOAT_EQ(0.1f, heightmap[1000]);
+  EXPECT_FLOAT_EQ(1.68609f, heightmap[5000]);
+  EXPECT_FLOAT_EQ(1.9026204f, heightmap[50000]);
+  EXPECT_FLOAT_EQ(0.1f, heightmap[100000]);
   EXPECT_FLOAT_EQ(0.1f, heightmap[150000]);
-  EXPECT_FLOAT_EQ(1.492384f,  heightmap[200000]);
+  EXPECT_FLOAT_EQ(1.9836402f, heightmap[200000]);
   EXPECT_FLOAT_EQ(0.1f, heightmap[250000]);
   EXPECT_FLOAT_EQ(0.1f, heightmap[262143]);
+  platec_api_destroy(p);
 }
 
-TEST(PlatecGlobalGeneration, SameResultAsPlatec)
+#ifndef PLATEC_COMPACT_PLATES
+TEST(PlatecGlobalGeneration, SameResultAsPinned)
 {
   long seed = 3;
   void* p = platec_api_create(seed, 512,512, 0.65,60,0.02,1000000,0.33,2,10);
@@ -60,15 +69,192 @@ TEST(PlatecGlobalGeneration, SameResultAsPlatec)
   }
   const float* heightmap = platec_api_get_heightmap(p);
 
-  EXPECT_FLOAT_EQ(2.0832214f, heightmap[0]);
-  EXPECT_FLOAT_EQ(0.089928061f, heightmap[100]);
-  EXPECT_FLOAT_EQ(0.092105672f, heightmap[200]);
-  EXPECT_FLOAT_EQ(0.10110986f,  heightmap[1000]);
-  EXPECT_FLOAT_EQ(0.10199541f, heightmap[5000]);
-  EXPECT_FLOAT_EQ(0.11336569f, heightmap[50000]);
-  EXPECT_FLOAT_EQ(1.0184617f,  heightmap[100000]);
-  EXPECT_FLOAT_EQ(0.84557754f,  heightmap[150000]);
-  EXPECT_FLOAT_EQ(0.12073194f, heightmap[200000]);
-  EXPECT_FLOAT_EQ(0.12088145f, heightmap[250000]);
-  EXPECT_FLOAT_EQ(2.1296265f, heightmap[262143]);
-}*/
+  EXPECT_FLOAT_EQ(0.10000732f, heightmap[0]);
+  EXPECT_FLOAT_EQ(0.09604095f, heightmap[100]);
+  EXPECT_FLOAT_EQ(0.093936346f, heightmap[200]);
+  EXPECT_FLOAT_EQ(0.10719945f, heightmap[1000]);
+  EXPECT_FLOAT_EQ(0.16632675f, heightmap[5000]);
+  EXPECT_FLOAT_EQ(0.10388458f, heightmap[50000]);
+  EXPECT_FLOAT_EQ(2.8632202f, heightmap[100000]);
+  EXPECT_FLOAT_EQ(0.27332175f, heightmap[150000]);
+  EXPECT_FLOAT_EQ(2.7779522f, heightmap[200000]);
+  EXPECT_FLOAT_EQ(0.10954516f, heightmap[250000]);
+  EXPECT_FLOAT_EQ(0.08678104f, heightmap[262143]);
+  platec_api_destroy(p);
+}
+#endif
+
+
+// Running the plates on several threads must not change the outcome.
+TEST(PlatecThreads, SameResultAsSingleThread)
+{
+    const uint32_t width = 128, height = 96;
+    void* single = platec_api_create(3, width, height, 0.65, 60, 0.02, 1000000, 0.33, 2, 10);
+    void* multi = platec_api_create(3, width, height, 0.65, 60, 0.02, 1000000, 0.33, 2, 10);
+    platec_api_set_thread_count(multi, 4);
+
+    for (int step = 0; step < 150; step++) {
+        platec_api_step(single);
+        platec_api_step(multi);
+    }
+
+    const float* hs = platec_api_get_heightmap(single);
+    const float* hm = platec_api_get_heightmap(multi);
+    const uint32_t* is = platec_api_get_platesmap(single);
+    const uint32_t* im = platec_api_get_platesmap(multi);
+    for (uint32_t i = 0; i < width * height; i++) {
+        ASSERT_EQ(hs[i], hm[i]);
+        ASSERT_EQ(is[i], im[i]);
+    }
+    platec_api_destroy(single);
+    platec_api_destroy(multi);
+}
+
+// Eroding the composed world, on any number of threads, must give the
+// same outcome too.
+TEST(PlatecThreads, WorldErosionSameResultAsSingleThread)
+{
+    const uint32_t width = 128, height = 96;
+    void* single = platec_api_create(3, width, height, 0.65, 60, 0.02, 1000000, 0.33, 2, 10);
+    void* multi = platec_api_create(3, width, height, 0.65, 60, 0.02, 1000000, 0.33, 2, 10);
+    platec_api_set_world_erosion(single, 1);
+    platec_api_set_world_erosion(multi, 1);
+    platec_api_set_thread_count(multi, 4);
+
+    for (int step = 0; step < 150; step++) {
+        platec_api_step(single);
+        platec_api_step(multi);
+    }
+
+    const float* hs = platec_api_get_heightmap(single);
+    const float* hm = platec_api_get_heightmap(multi);
+    for (uint32_t i = 0; i < width * height; i++) {
+        ASSERT_EQ(hs[i], hm[i]);
+    }
+    platec_api_destroy(single);
+    platec_api_destroy(multi);
+}
+
+// The plates map stays where it is from one step to the next, so callers
+// may keep the pointer around.
+TEST(PlatecPlatesMap, StablePointerAcrossSteps)
+{
+    const uint32_t width = 128, height = 96;
+    void* p = platec_api_create(3, width, height, 0.65, 60, 0.02, 1000000, 0.33, 2, 10);
+    const uint32_t* cached = platec_api_get_platesmap(p);
+
+    for (int step = 0; step < 10; step++) {
+        platec_api_step(p);
+        ASSERT_EQ(cached, platec_api_get_platesmap(p));
+        for (uint32_t i = 0; i < width * height; i++) {
+            ASSERT_LT(cached[i], 10u);
+        }
+    }
+    platec_api_destroy(p);
+}
+
+// Number of points whose owner on the plates map has no crust there while
+// some other plate has.
+static uint32_t countStaleOwners(const lithosphere& litho)
+{
+    const uint32_t width = litho.getWidth(), height = litho.getHeight();
+    const uint32_t* owners = litho.getPlatesMap();
+    uint32_t stale = 0;
+    for (uint32_t y = 0; y < height; y++) {
+        for (uint32_t x = 0; x < width; x++) {
+            const uint32_t owner = owners[y * width + x];
+            if (owner >= litho.getPlateCount() ||
+                    litho.getPlate(owner)->getCrust(x, y) > 0)
+                continue;
+            for (uint32_t i = 0; i < litho.getPlateCount(); i++) {
+                if (litho.getPlate(i)->getCrust(x, y) > 0) {
+                    stale++;
+                    break;
+                }
+            }
+        }
+    }
+    return stale;
+}
+
+// Crust aggregated to another plate changes owner within the step when the
+// world is eroded as a whole, so that the erosion reaches it. Both worlds
+// are the same until the first erosion.
+TEST(PlatecWorldErosion, AggregatedCrustChangesOwner)
+{
+    lithosphere plain(1, 128, 96, 0.65, 60, 0.02, 1000000, 0.33, 2, 10);
+    lithosphere world(1, 128, 96, 0.65, 60, 0.02, 1000000, 0.33, 2, 10);
+    world.setWorldErosion(true);
+
+    uint32_t stale = 0;
+    for (int step = 0; step < 5; step++) {
+        plain.update();
+        world.update();
+        stale += countStaleOwners(plain);
+        ASSERT_EQ(0u, countStaleOwners(world));
+    }
+    EXPECT_GT(stale, 0u);
+}
+
+// Simulations stepped on different threads at the same time must not
+// disturb each other.
+TEST(PlatecThreads, ConcurrentSimulationsSameAsAlone)
+{
+    const uint32_t width = 128, height = 96;
+    void* alone = platec_api_create(7, width, height, 0.65, 60, 0.02, 1000000, 0.33, 2, 10);
+    for (int step = 0; step < 100; step++) {
+        platec_api_step(alone);
+    }
+
+    // The simulations are also destroyed at the same time, so that both
+    // adding to and removing from the registry of the C API run together.
+    const float* ha = platec_api_get_heightmap(alone);
+    uint32_t differences[2] = { 0, 0 };
+    #pragma omp parallel for num_threads(2)
+    for (int i = 0; i < 2; i++) {
+        void* simulation = platec_api_create(7, width, height, 0.65, 60, 0.02, 1000000, 0.33, 2, 10);
+        for (int step = 0; step < 100; step++) {
+            platec_api_step(simulation);
+        }
+
+        const float* hc = platec_api_get_heightmap(simulation);
+        for (uint32_t k = 0; k < width * height; k++) {
+            differences[i] += ha[k] != hc[k];
+        }
+        platec_api_destroy(simulation);
+    }
+
+    EXPECT_EQ(0u, differences[0]);
+    EXPECT_EQ(0u, differences[1]);
+    platec_api_destroy(alone);
+}
+
+// Statistics of the world after 100 steps with plates kept in floats. The
+// compact plates (WITH_COMPACT_PLATES) round their crust, which changes
+// the details of the outcome but must not change the overall picture.
+TEST(PlatecStatistics, CloseToFloatPlates)
+{
+    const uint32_t width = 128, height = 96;
+    const long seeds[] = { 3, 7, 11 };
+    const float mean_heights[] = { 0.75643f, 0.80221f, 0.77564f };
+    const float land_fractions[] = { 0.27507f, 0.29989f, 0.25716f };
+
+    for (int s = 0; s < 3; s++) {
+        void* p = platec_api_create(seeds[s], width, height, 0.65, 60, 0.02, 1000000, 0.33, 2, 10);
+        for (int step = 0; step < 100; step++) {
+            platec_api_step(p);
+        }
+
+        const float* heightmap = platec_api_get_heightmap(p);
+        double sum = 0;
+        uint32_t land = 0;
+        for (uint32_t i = 0; i < width * height; i++) {
+            sum += heightmap[i];
+            land += heightmap[i] >= 1.0f;
+        }
+
+        EXPECT_NEAR(mean_heights[s], sum / (width * height), 0.02 * mean_heights[s]);
+        EXPECT_NEAR(land_fractions[s], (double)land / (width * height), 0.01);
+        platec_api_destroy(p);
+    }
+}
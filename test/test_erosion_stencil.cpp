@@ -0,0 +1,190 @@
+/******************************************************************************
+ *  plate-tectonics, a plate tectonics simulation library
+ *  Copyright (C) 2012-2013 Lauri Viitanen
+ *  Copyright (C) 2014-2015 Federico Tomassetti, Bret Curtis
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, see http://www.gnu.org/licenses/
+ *****************************************************************************/
+
+#include <cstring>
+#include "erosion_stencil.hpp"
+#include "tile_occupancy.hpp"
+#include "plate_storage.hpp"
+#include "simplerandom.hpp"
+#include "gtest/gtest.h"
+
+// The point by point loop plate::erode used to run.
+static void referenceErode(const float* map, float* out, uint32_t width,
+                           uint32_t height, bool wrap_x, bool wrap_y,
+                           float lower_bound, const TileOccupancy& tiles)
+{
+    for (uint32_t y = 0; y < height; ++y)
+    for (uint32_t x0, x1 = 0; tiles.nextRun(y, x1, width, x0, x1);)
+    for (uint32_t x = x0; x < x1; ++x)
+    {
+        const uint32_t index = y * width + x;
+        out[index] += map[index];
+        if (map[index] < lower_bound)
+            continue;
+
+        const uint32_t w_mask = -((x > 0) | wrap_x);
+        const uint32_t e_mask = -((x < width - 1) | wrap_x);
+        const uint32_t n_mask = -((y > 0) | wrap_y);
+        const uint32_t s_mask = -((y < height - 1) | wrap_y);
+        uint32_t w = w_mask ? (x == 0 ? width - 1 : x - 1) : 0;
+        uint32_t e = e_mask ? (x + 1 == width ? 0 : x + 1) : 0;
+        uint32_t n = n_mask ? (y == 0 ? height - 1 : y - 1) : 0;
+        uint32_t s = s_mask ? (y + 1 == height ? 0 : y + 1) : 0;
+        w = y * width + w;
+        e = y * width + e;
+        n = n * width + x;
+        s = s * width + x;
+
+        float w_crust = map[w] * (w_mask & (map[w] < map[index]));
+        float e_crust = map[e] * (e_mask & (map[e] < map[index]));
+        float n_crust = map[n] * (n_mask & (map[n] < map[index]));
+        float s_crust = map[s] * (s_mask & (map[s] < map[index]));
+        if (w_crust + e_crust + n_crust + s_crust == 0)
+            continue;
+
+        float w_diff = map[index] - w_crust;
+        float e_diff = map[index] - e_crust;
+        float n_diff = map[index] - n_crust;
+        float s_diff = map[index] - s_crust;
+
+        float min_diff = w_diff;
+        min_diff -= (min_diff - e_diff) * (e_diff < min_diff);
+        min_diff -= (min_diff - n_diff) * (n_diff < min_diff);
+        min_diff -= (min_diff - s_diff) * (s_diff < min_diff);
+
+        float diff_sum = (w_diff - min_diff) * (w_crust > 0) +
+                         (e_diff - min_diff) * (e_crust > 0) +
+                         (n_diff - min_diff) * (n_crust > 0) +
+                         (s_diff - min_diff) * (s_crust > 0);
+
+        if (diff_sum < min_diff)
+        {
+            out[w] += (w_diff - min_diff) * (w_crust > 0);
+            out[e] += (e_diff - min_diff) * (e_crust > 0);
+            out[n] += (n_diff - min_diff) * (n_crust > 0);
+            out[s] += (s_diff - min_diff) * (s_crust > 0);
+            out[index] -= min_diff;
+
+            min_diff -= diff_sum;
+            min_diff /= 1 + (w_crust > 0) + (e_crust > 0) +
+                        (n_crust > 0) + (s_crust > 0);
+
+            out[w] += min_diff * (w_crust > 0);
+            out[e] += min_diff * (e_crust > 0);
+            out[n] += min_diff * (n_crust > 0);
+            out[s] += min_diff * (s_crust > 0);
+            out[index] += min_diff;
+        }
+        else
+        {
+            float unit = min_diff / diff_sum;
+            out[index] -= min_diff;
+            out[w] += unit * (w_diff - min_diff) * (w_crust > 0);
+            out[e] += unit * (e_diff - min_diff) * (e_crust > 0);
+            out[n] += unit * (n_diff - min_diff) * (n_crust > 0);
+            out[s] += unit * (s_diff - min_diff) * (s_crust > 0);
+        }
+    }
+}
+
+// Random crust with some flat areas, leaving the tiles of column "empty"
+// without any.
+static void randomCrust(CrustMap& crust, uint32_t seed, uint32_t empty)
+{
+    SimpleRandom r(seed);
+    for (uint32_t y = 0; y < crust.height(); ++y)
+        for (uint32_t x = 0; x < crust.width(); ++x) {
+            const uint32_t v = r.next() % 8;
+            crust.set(x, y, x / 64 == empty ? 0.0f :
+                            v == 0 ? 1.0f : (float)(r.next() % 1000) / 250.0f);
+        }
+}
+
+static void checkErode(uint32_t width, uint32_t height, bool wrap_x,
+                       bool wrap_y, uint32_t empty)
+{
+    CrustMap crust(width, height);
+    randomCrust(crust, width * height + empty, empty);
+    TileOccupancy tiles;
+    tiles.build(crust);
+    HeightMap map(1, 1);
+    widenCrust(map, crust);
+
+    HeightMap expected(width, height), actual(width, height);
+    expected.set_all(0.0f);
+    actual.set_all(0.0f);
+    referenceErode(map.raw_data(), expected.raw_data(), width, height,
+                   wrap_x, wrap_y, 0.5f, tiles);
+    ErosionStencil stencil;
+    stencil.erode(map.raw_data(), actual.raw_data(), width, height,
+                  wrap_x, wrap_y, 0.5f, tiles);
+
+    for (uint32_t i = 0; i < width * height; ++i)
+        ASSERT_EQ(0, memcmp(&expected[i], &actual[i], sizeof(float)))
+            << "at " << i << ": " << expected[i] << " != " << actual[i];
+
+    // Bands of rows eroded apart, in any order, give the same.
+    HeightMap banded(width, height);
+    banded.set_all(-1.0f);
+    for (uint32_t band = 3; band-- > 0;) {
+        ErosionStencil part;
+        part.erode(map.raw_data(), banded.raw_data(), width, height, wrap_x,
+                   wrap_y, 0.5f, tiles, band * height / 3, (band + 1) * height / 3);
+    }
+    for (uint32_t i = 0; i < width * height; ++i)
+        ASSERT_EQ(0, memcmp(&expected[i], &banded[i], sizeof(float)))
+            << "at " << i << ": " << expected[i] << " != " << banded[i];
+}
+
+TEST(ErosionStencil, MatchesPointByPointLoop)
+{
+    checkErode(200, 70, false, false, 9);
+    checkErode(200, 70, false, false, 1);
+    checkErode(131, 67, true, false, 9);
+    checkErode(131, 67, false, true, 0);
+    checkErode(131, 67, true, true, 1);
+    checkErode(5, 5, true, true, 9);
+    checkErode(1, 3, false, false, 9);
+    checkErode(3, 1, false, false, 9);
+}
+
+TEST(ErosionStencil, VectorizedSharesMatchScalar)
+{
+    const uint32_t width = 37, height = 4;
+    CrustMap crust(width, height);
+    randomCrust(crust, 7, 9);
+    HeightMap map(1, 1);
+    widenCrust(map, crust);
+
+    ErosionStencil scalar, simd;
+    for (uint32_t y = 0; y < height; ++y) {
+        scalar.flow(map.raw_data(), width, height, y, 0, width, y & 1, y & 2, 0.5f, false);
+        simd.flow(map.raw_data(), width, height, y, 0, width, y & 1, y & 2, 0.5f, true);
+
+        for (uint32_t x = 0; x < width; ++x) {
+            float a0[5], b0[5], a1[5], b1[5];
+            scalar.share(x, a0, b0);
+            simd.share(x, a1, b1);
+            for (uint32_t i = 0; i < 5; ++i) {
+                EXPECT_EQ(a0[i], a1[i]) << x << ", " << y;
+                EXPECT_EQ(b0[i], b1[i]) << x << ", " << y;
+            }
+        }
+    }
+}
@@ -0,0 +1,92 @@
+/******************************************************************************
+ *  plate-tectonics, a plate tectonics simulation library
+ *  Copyright (C) 2012-2013 Lauri Viitanen
+ *  Copyright (C) 2014-2015 Federico Tomassetti, Bret Curtis
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, see http://www.gnu.org/licenses/
+ *****************************************************************************/
+
+#include "flow_accumulation.hpp"
+#include "tile_occupancy.hpp"
+#include "plate_storage.hpp"
+#include "gtest/gtest.h"
+
+static void computeFlow(FlowAccumulation& flow, const float* heights,
+                        uint32_t width, uint32_t height, bool wrap_x,
+                        bool wrap_y, float lower_bound)
+{
+    CrustMap crust(width, height);
+    for (uint32_t i = 0; i < width * height; ++i)
+        crust[i] = heights[i];
+    TileOccupancy tiles;
+    tiles.build(crust);
+    flow.compute(heights, width, height, wrap_x, wrap_y, lower_bound, tiles);
+}
+
+TEST(FlowAccumulation, SlopeDrainsToTheSea)
+{
+    // Land rising to the east, sea on the west.
+    const float heights[4 * 3] = {
+        0, 2, 3, 4,
+        0, 2, 3, 4,
+        0, 2, 3, 4 };
+    FlowAccumulation flow;
+    computeFlow(flow, heights, 4, 3, false, false, 1.0f);
+
+    EXPECT_EQ(0, flow.accumulation()[0]);
+    EXPECT_EQ(1, flow.accumulation()[3]);
+    EXPECT_EQ(2, flow.accumulation()[6]);
+    EXPECT_EQ(3, flow.accumulation()[5]);
+    EXPECT_EQ(4 + 1, flow.receivers()[6]);
+    EXPECT_EQ(4, flow.receivers()[5]);
+    EXPECT_EQ(9, flow.order().size());
+}
+
+TEST(FlowAccumulation, DepressionSpillsOver)
+{
+    // A pit at (2, 1) drains over the lowest point of its rim, (1, 1).
+    const float heights[5 * 3] = {
+        0, 5, 5, 5, 5,
+        0, 3, 2, 5, 5,
+        0, 5, 5, 5, 5 };
+    FlowAccumulation flow;
+    computeFlow(flow, heights, 5, 3, false, true, 1.0f);
+
+    EXPECT_EQ(5 + 1, flow.receivers()[5 + 2]);
+    EXPECT_EQ(5, flow.receivers()[5 + 1]);
+
+    // Every point comes after the one it drains to.
+    std::vector<uint32_t> position(15, 0xFFFFFFFF);
+    for (uint32_t k = 0; k < flow.order().size(); ++k)
+        position[flow.order()[k]] = k;
+    for (uint32_t k = 0; k < flow.order().size(); ++k) {
+        const uint32_t r = flow.receivers()[flow.order()[k]];
+        if (r != FlowAccumulation::NONE && heights[r] >= 1.0f)
+            EXPECT_LT(position[r], k);
+    }
+}
+
+TEST(FlowAccumulation, AllLandDrainsFromItsLowestPoint)
+{
+    const float heights[3 * 3] = {
+        4, 4, 4,
+        4, 2, 4,
+        4, 4, 4 };
+    FlowAccumulation flow;
+    computeFlow(flow, heights, 3, 3, true, true, 1.0f);
+
+    EXPECT_EQ(4, flow.order()[0]);
+    EXPECT_EQ(FlowAccumulation::NONE, flow.receivers()[4]);
+    EXPECT_EQ(9, flow.accumulation()[4]);
+}
@@ -75,6 +75,45 @@ TEST(HeightMap, AssignmentOperator)
     ASSERT_TRUE(0.9f == hm2.get(49, 19));
 }
 
+TEST(HeightMap, Grow)
+{
+    HeightMap hm = HeightMap(50, 20);
+    hm.set_all(0.5f);
+    hm.set( 0,  0, 0.2f);
+    hm.set(49, 19, 0.9f);
+
+    // The first growth reallocates, the second one fits the slack.
+    hm.grow(58, 28, 8, 0, 0.0f);
+    hm.grow(66, 36, 0, 8, 0.0f);
+    ASSERT_EQ(66, hm.width());
+    ASSERT_EQ(36, hm.height());
+    ASSERT_EQ(66 * 36, hm.area());
+    ASSERT_TRUE(0.2f == hm.get( 8,  8));
+    ASSERT_TRUE(0.9f == hm.get(57, 27));
+    ASSERT_TRUE(0.5f == hm.get(30, 20));
+    ASSERT_TRUE(0.0f == hm.get( 7,  8));
+    ASSERT_TRUE(0.0f == hm.get(58,  8));
+    ASSERT_TRUE(0.0f == hm.get(30,  7));
+    ASSERT_TRUE(0.0f == hm.get(30, 28));
+    ASSERT_TRUE(0.0f == hm.get(65, 35));
+}
+
+TEST(HeightMap, Crop)
+{
+    HeightMap hm = HeightMap(50, 20);
+    hm.set_all(0.0f);
+    hm.set(10,  5, 0.2f);
+    hm.set(19, 14, 0.9f);
+
+    hm.crop(10, 5, 10, 10);
+    ASSERT_EQ(10, hm.width());
+    ASSERT_EQ(10, hm.height());
+    ASSERT_EQ(100, hm.area());
+    ASSERT_TRUE(0.2f == hm.get(0, 0));
+    ASSERT_TRUE(0.9f == hm.get(9, 9));
+    ASSERT_TRUE(0.0f == hm.get(5, 5));
+}
+
 TEST(HeightMap, SetAll)
 {
     HeightMap hm = HeightMap(50, 20);
@@ -85,6 +124,60 @@ TEST(HeightMap, SetAll)
     ASSERT_TRUE(1.789f == hm.get(49, 19));
 }
 
+TEST(HeightMap, SetAllNonUniformBytes)
+{
+    AgeMap am = AgeMap(50, 20);
+    am.set_all(0x01020304);
+    ASSERT_EQ(0x01020304, am.get( 0,  0));
+    ASSERT_EQ(0x01020304, am.get(49, 19));
+    am.set_all(0);
+    ASSERT_EQ(0, am.get(20, 18));
+}
+
+TEST(HeightMap, StorageIsAligned)
+{
+    HeightMap hm = HeightMap(50, 20);
+    ASSERT_EQ(0u, (uintptr_t)hm.raw_data() % Platec::MATRIX_ALIGNMENT);
+    hm.grow(80, 40, 10, 10, 0.0f);
+    ASSERT_EQ(0u, (uintptr_t)hm.raw_data() % Platec::MATRIX_ALIGNMENT);
+}
+
+TEST(HeightMap, Swap)
+{
+    HeightMap hm = HeightMap(50, 20);
+    hm.set_all(0.5f);
+    HeightMap hm2 = HeightMap(10, 10);
+    hm2.set_all(0.25f);
+    const float* data = hm.raw_data();
+
+    hm.swap(hm2);
+    ASSERT_EQ(10, hm.width());
+    ASSERT_EQ(10, hm.height());
+    ASSERT_EQ(50, hm2.width());
+    ASSERT_EQ(20, hm2.height());
+    ASSERT_EQ(data, hm2.raw_data());
+    ASSERT_TRUE(0.25f == hm.get(9, 9));
+    ASSERT_TRUE(0.5f == hm2.get(49, 19));
+}
+
+TEST(HeightMap, View)
+{
+    HeightMap hm = HeightMap(50, 20);
+    hm.set(10,  5, 0.2f);
+    hm.set(19, 14, 0.9f);
+
+    MatrixView<float> v = hm.view(10, 5, 10, 10);
+    ASSERT_EQ(10, v.width());
+    ASSERT_EQ(10, v.height());
+    ASSERT_EQ(50, v.stride());
+    ASSERT_TRUE(0.2f == v(0, 0));
+    ASSERT_TRUE(0.9f == v(9, 9));
+    ASSERT_TRUE(0.9f == v.row(9)[9]);
+
+    v(5, 5) = 0.7f;
+    ASSERT_TRUE(0.7f == hm.get(15, 10));
+}
+
 TEST(HeightMap, IndexedAccessOperatorFromIndex)
 {
     HeightMap hm = HeightMap(50, 20);
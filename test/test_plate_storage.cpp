@@ -0,0 +1,133 @@
+/******************************************************************************
+ *  plate-tectonics, a plate tectonics simulation library
+ *  Copyright (C) 2012-2013 Lauri Viitanen
+ *  Copyright (C) 2014-2015 Federico Tomassetti, Bret Curtis
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, see http://www.gnu.org/licenses/
+ *****************************************************************************/
+
+#include "plate_storage.hpp"
+#include "simplerandom.hpp"
+#include "gtest/gtest.h"
+#include <cmath>
+
+TEST(Half, EveryHalfSurvivesRoundTrip)
+{
+    for (uint32_t bits = 0; bits < 0x10000; ++bits) {
+        const uint16_t half = (uint16_t)bits;
+        if ((half & 0x7C00) == 0x7C00)
+            continue; // Infinities and NaNs are not used.
+        ASSERT_EQ(half, Platec::floatToHalf(Platec::halfToFloat(half)));
+    }
+}
+
+TEST(Half, KnownValues)
+{
+    EXPECT_EQ(0x0000, Platec::floatToHalf(0.0f));
+    EXPECT_EQ(0x3C00, Platec::floatToHalf(1.0f));
+    EXPECT_EQ(0xC000, Platec::floatToHalf(-2.0f));
+    EXPECT_EQ(0x3555, Platec::floatToHalf(1.0f / 3));
+    EXPECT_EQ(0x0001, Platec::floatToHalf(5.9604645e-8f)); // Smallest subnormal.
+    EXPECT_EQ(Platec::HALF_MAX_BITS, Platec::floatToHalf(65504.0f));
+    EXPECT_FLOAT_EQ(65504.0f, Platec::halfToFloat(Platec::HALF_MAX_BITS));
+    EXPECT_FLOAT_EQ(0.5f, Platec::halfToFloat(0x3800));
+}
+
+TEST(Half, TiesRoundToEven)
+{
+    // Halves next to 1 are 2^-10 apart.
+    EXPECT_EQ(0x3C00, Platec::floatToHalf(1.0f + 1.0f / 2048));
+    EXPECT_EQ(0x3C02, Platec::floatToHalf(1.0f + 3.0f / 2048));
+    EXPECT_EQ(0x3C01, Platec::floatToHalf(1.0f + 1.0f / 2048 + 1.0f / 65536));
+}
+
+TEST(Half, LargeValuesSaturate)
+{
+    EXPECT_EQ(Platec::HALF_MAX_BITS, Platec::floatToHalf(65519.0f));
+    EXPECT_EQ(Platec::HALF_MAX_BITS, Platec::floatToHalf(1e9f));
+    EXPECT_EQ(0x8000 | Platec::HALF_MAX_BITS, Platec::floatToHalf(-1e9f));
+}
+
+// Rounding error is at most half a unit in the last place: 2^-11 relative
+// to the value for normal halves, 2^-25 absolute for subnormal ones.
+TEST(Half, ErrorIsBounded)
+{
+    SimpleRandom rand(42);
+    for (uint32_t i = 0; i < 100000; ++i) {
+        const float value = (float)(std::pow(2.0, rand.next_double() * 40 - 26) *
+                                    (rand.next() % 2 ? 1 : -1));
+        const float rounded = Platec::halfToFloat(Platec::floatToHalf(value));
+        const float bound = std::max(std::fabs(value) / 2048, 1.0f / (1 << 25));
+        ASSERT_LE(std::fabs(rounded - value), bound) << value;
+    }
+}
+
+TEST(PlateStorage, AgesSaturate)
+{
+    EXPECT_EQ(600u, narrowAge(600));
+    uint32_t world[3] = { 0, 20, 1000 };
+    CrustAgeMap plate(4, 1);
+    plate.set_all(7);
+    narrowAges(plate, 1, world, 3);
+    EXPECT_EQ(7u, plate.get(0, 0));
+    EXPECT_EQ(0u, plate.get(1, 0));
+    EXPECT_EQ(20u, plate.get(2, 0));
+    EXPECT_EQ(1000u, plate.get(3, 0));
+#ifdef PLATEC_COMPACT_PLATES
+    EXPECT_EQ(0xFFFFu, narrowAge(100000));
+#endif
+}
+
+TEST(PlateStorage, CrustKeepsItsSideOfContinentalBase)
+{
+    // Floats just below CONT_BASE would round to it as halves.
+    const float below = (float)CONT_BASE - 1e-5f;
+    const Crust crust = below;
+    EXPECT_LT((float)crust, CONT_BASE);
+    EXPECT_NEAR(below, (float)crust, 1.0f / 2048);
+
+    Crust sum = 0.5f;
+    sum += 0.5f - 1e-5f;
+    EXPECT_LT((float)sum, CONT_BASE);
+    sum += 1e-3f;
+    EXPECT_GE((float)sum, CONT_BASE);
+}
+
+TEST(PlateStorage, CrustWidensAndNarrows)
+{
+    HeightMap heights(20, 10);
+    for (uint32_t i = 0; i < heights.area(); ++i)
+        heights[i] = 0.1f * i;
+
+    CrustMap crust(1, 1);
+    HeightMap copy(heights);
+    adoptCrust(crust, copy);
+    ASSERT_EQ(20u, crust.width());
+    ASSERT_EQ(10u, crust.height());
+    EXPECT_EQ(1u, copy.area());
+
+    HeightMap wide(1, 1);
+    widenCrust(wide, crust);
+    ASSERT_EQ(crust.area(), wide.area());
+    for (uint32_t i = 0; i < heights.area(); ++i) {
+        EXPECT_NEAR(heights[i], wide[i], heights[i] / 2048);
+        EXPECT_EQ((float)crust[i], wide[i]);
+    }
+
+    for (uint32_t i = 0; i < wide.area(); ++i)
+        wide[i] += 1.0f;
+    narrowCrust(crust, wide);
+    for (uint32_t i = 0; i < heights.area(); ++i)
+        EXPECT_NEAR(heights[i] + 1.0f, crust[i], (heights[i] + 1.0f) / 1024);
+}
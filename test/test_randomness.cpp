@@ -20,6 +20,7 @@
 #include "platecapi.hpp"
 #include "gtest/gtest.h"
 #include <cstdlib>
+#include <vector>
 #include "simplerandom.hpp"
 
 using namespace std;
@@ -41,3 +42,53 @@ TEST(Randomness, Maximum)
 
     EXPECT_FLOAT_EQ((float)4.2949673e+09, (float)randsource.maximum());
 }
+
+TEST(Randomness, JumpSameAsNext)
+{
+    SimpleRandom stepped(3);
+    SimpleRandom jumped(3);
+    for (uint32_t i = 0; i < 1000; i++) {
+        stepped.next();
+    }
+    jumped.jump(1000);
+    EXPECT_EQ(stepped.next(), jumped.next());
+
+    // Jumping a whole period around leaves the generator where it was.
+    jumped.jump(UINT64_C(0x100000000));
+    EXPECT_EQ(stepped.next(), jumped.next());
+}
+
+TEST(Randomness, FillSameAsNextDouble)
+{
+    SimpleRandom stepped(3);
+    SimpleRandom filled(3);
+    vector<double> values(1003);
+    filled.fill_double(&values[0], 3);
+    filled.fill_double(&values[3], 1000);
+    for (uint32_t i = 0; i < values.size(); i++) {
+        EXPECT_EQ(stepped.next_double(), values[i]);
+    }
+    EXPECT_EQ(stepped.next(), filled.next());
+}
+
+TEST(Randomness, StreamsAreRepeatableAndIndependent)
+{
+    RandomStream stream(3, 1, 10);
+    RandomStream same(3, 1, 10);
+    RandomStream otherPlate(3, 2, 10);
+    RandomStream otherStep(3, 1, 11);
+
+    vector<double> values(100);
+    stream.fill_double(&values[0], 50, 100);
+    uint32_t equalPlate = 0, equalStep = 0;
+    for (uint32_t i = 0; i < 100; i++) {
+        EXPECT_EQ(same.at(i), stream.at(i));
+        EXPECT_EQ(stream.double_at(50 + i), values[i]);
+        EXPECT_LE(0.0, values[i]);
+        EXPECT_GE(1.0, values[i]);
+        equalPlate += otherPlate.at(i) == stream.at(i);
+        equalStep += otherStep.at(i) == stream.at(i);
+    }
+    EXPECT_EQ(0, equalPlate);
+    EXPECT_EQ(0, equalStep);
+}
@@ -157,3 +157,53 @@ TEST(Rectangle, MapIndexInsideRectLargeAsWorld)
     ASSERT_EQ(py, 29);
     ASSERT_EQ(res, 1499);
 }
+
+TEST(WrappedRect, InsideWorld)
+{
+    Platec::WrappedRect r(WorldDimension(50, 30), 10, 5, 20, 8);
+
+    ASSERT_EQ(1, r.columnSpans());
+    EXPECT_EQ(0, r.columnSpan(0).plate);
+    EXPECT_EQ(10, r.columnSpan(0).world);
+    EXPECT_EQ(20, r.columnSpan(0).length);
+
+    ASSERT_EQ(1, r.rowSpans());
+    EXPECT_EQ(0, r.rowSpan(0).plate);
+    EXPECT_EQ(5, r.rowSpan(0).world);
+    EXPECT_EQ(8, r.rowSpan(0).length);
+}
+
+TEST(WrappedRect, WrappingOnBothAxes)
+{
+    Platec::WrappedRect r(WorldDimension(50, 30), 42, 25, 20, 10);
+
+    ASSERT_EQ(2, r.columnSpans());
+    EXPECT_EQ(0, r.columnSpan(0).plate);
+    EXPECT_EQ(42, r.columnSpan(0).world);
+    EXPECT_EQ(8, r.columnSpan(0).length);
+    EXPECT_EQ(8, r.columnSpan(1).plate);
+    EXPECT_EQ(0, r.columnSpan(1).world);
+    EXPECT_EQ(12, r.columnSpan(1).length);
+
+    ASSERT_EQ(2, r.rowSpans());
+    EXPECT_EQ(0, r.rowSpan(0).plate);
+    EXPECT_EQ(25, r.rowSpan(0).world);
+    EXPECT_EQ(5, r.rowSpan(0).length);
+    EXPECT_EQ(5, r.rowSpan(1).plate);
+    EXPECT_EQ(0, r.rowSpan(1).world);
+    EXPECT_EQ(5, r.rowSpan(1).length);
+}
+
+TEST(WrappedRect, LargeAsWorld)
+{
+    Platec::WrappedRect r(WorldDimension(50, 30), 0, 7, 50, 30);
+
+    ASSERT_EQ(1, r.columnSpans());
+    EXPECT_EQ(50, r.columnSpan(0).length);
+
+    ASSERT_EQ(2, r.rowSpans());
+    EXPECT_EQ(23, r.rowSpan(0).length);
+    EXPECT_EQ(23, r.rowSpan(1).plate);
+    EXPECT_EQ(0, r.rowSpan(1).world);
+    EXPECT_EQ(7, r.rowSpan(1).length);
+}
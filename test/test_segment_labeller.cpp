@@ -0,0 +1,257 @@
+/******************************************************************************
+ *  plate-tectonics, a plate tectonics simulation library
+ *  Copyright (C) 2012-2013 Lauri Viitanen
+ *  Copyright (C) 2014-2015 Federico Tomassetti, Bret Curtis
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, see http://www.gnu.org/licenses/
+ *****************************************************************************/
+
+#include <stdexcept>
+
+#include "segment_labeller.hpp"
+#include "segments.hpp"
+#include "gtest/gtest.h"
+
+// ID of points without continental crust.
+static const ContinentId UNLABELLED = (ContinentId)-1;
+
+// Build a height map from rows of text, '#' marks continental crust.
+CrustMap textToMap(const char** rows, uint32_t width, uint32_t height)
+{
+    CrustMap map(width, height);
+    for (uint32_t y = 0; y < height; ++y)
+        for (uint32_t x = 0; x < width; ++x)
+            map.set(x, y, rows[y][x] == '#' ? 1.5f : 0.5f);
+    return map;
+}
+
+TEST(SegmentLabeller, SeparateContinents)
+{
+    const char* rows[] = {
+        "##......",
+        "##...###",
+        ".....#..",
+        "........"
+    };
+    const WorldDimension wd(100, 100);
+    CrustMap map = textToMap(rows, 8, 4);
+    Segments segments(8, 4);
+    SegmentLabeller(wd).label(map, 8, 4, segments);
+
+    ASSERT_EQ(2, segments.size());
+    EXPECT_EQ(0, segments.id(0));
+    EXPECT_EQ(0, segments.id(9));
+    EXPECT_EQ(1, segments.id(13));
+    EXPECT_EQ(1, segments.id(21));
+    EXPECT_EQ(UNLABELLED, segments.id(2));
+
+    EXPECT_EQ(4, segments[0].area());
+    EXPECT_EQ(0, segments[0].getLeft());
+    EXPECT_EQ(1, segments[0].getRight());
+    EXPECT_EQ(0, segments[0].getTop());
+    EXPECT_EQ(1, segments[0].getBottom());
+
+    EXPECT_EQ(4, segments[1].area());
+    EXPECT_EQ(5, segments[1].getLeft());
+    EXPECT_EQ(7, segments[1].getRight());
+    EXPECT_EQ(1, segments[1].getTop());
+    EXPECT_EQ(2, segments[1].getBottom());
+}
+
+TEST(SegmentLabeller, ContinentJoinedBelow)
+{
+    // The arms of the U meet only on the last row.
+    const char* rows[] = {
+        "#...#.#",
+        "#...#..",
+        "#####.."
+    };
+    const WorldDimension wd(100, 100);
+    CrustMap map = textToMap(rows, 7, 3);
+    Segments segments(7, 3);
+    SegmentLabeller(wd).label(map, 7, 3, segments);
+
+    ASSERT_EQ(2, segments.size());
+    EXPECT_EQ(0, segments.id(0));
+    EXPECT_EQ(0, segments.id(4));
+    EXPECT_EQ(1, segments.id(6));
+    EXPECT_EQ(9, segments[0].area());
+    EXPECT_EQ(1, segments[1].area());
+}
+
+TEST(SegmentLabeller, WrapsAroundWorldSizedPlate)
+{
+    const char* rows[] = {
+        "#......",
+        ".......",
+        "#.....#"
+    };
+    CrustMap map = textToMap(rows, 7, 3);
+
+    // As wide and as tall as the world: all three points are one continent.
+    Segments wrapping(7, 3);
+    SegmentLabeller(WorldDimension(7, 3)).label(map, 7, 3, wrapping);
+    ASSERT_EQ(1, wrapping.size());
+    EXPECT_EQ(3, wrapping[0].area());
+
+    // Smaller than the world: nothing wraps.
+    Segments plain(7, 3);
+    SegmentLabeller(WorldDimension(8, 4)).label(map, 7, 3, plain);
+    EXPECT_EQ(3, plain.size());
+}
+
+// Ask the flood fill for every continental point in scan order.
+static void createAll(MySegmentCreator& creator, const CrustMap& map,
+                      uint32_t width, uint32_t height)
+{
+    for (uint32_t y = 0; y < height; ++y)
+        for (uint32_t x = 0; x < width; ++x)
+            if (map.get(x, y) >= CONT_BASE)
+                creator.createSegment(x, y);
+}
+
+// A checkerboard of continental points has a continent on every other
+// point. Compact plates cannot number that many and must say so instead
+// of reusing IDs.
+TEST(SegmentLabeller, MoreContinentsThanIds)
+{
+    const uint32_t width = 512, height = 258;
+    const uint32_t count = width * height / 2;
+    const WorldDimension wd(1024, 1024);
+    CrustMap map(width, height);
+    for (uint32_t y = 0; y < height; ++y)
+        for (uint32_t x = 0; x < width; ++x)
+            map.set(x, y, (x + y) % 2 == 0 ? 1.5f : 0.5f);
+    ASSERT_GT(count, 65535u);
+
+    Segments labelled(width, height);
+    Bounds bounds(wd, FloatPoint(0, 0), Dimension(width, height));
+    Segments filled(width, height);
+    PlateScratch scratch;
+    MySegmentCreator creator(bounds, &filled, map, wd, scratch);
+
+#ifdef PLATEC_COMPACT_PLATES
+    EXPECT_THROW(SegmentLabeller(wd).label(map, width, height, labelled),
+                 std::runtime_error);
+    EXPECT_THROW(createAll(creator, map, width, height), std::runtime_error);
+#else
+    SegmentLabeller(wd).label(map, width, height, labelled);
+    EXPECT_EQ(count, labelled.size());
+    EXPECT_EQ(count - 1, labelled.id(width * height - 1));
+
+    createAll(creator, map, width, height);
+    EXPECT_EQ(count, filled.size());
+#endif
+}
+
+// The labeller must find the very same partition the flood fill finds when
+// it's asked for every continental point in scan order.
+void expectSameAsFloodFill(uint32_t seed, uint32_t width, uint32_t height,
+                           const WorldDimension& wd)
+{
+    SimpleRandom rand(seed);
+    CrustMap map(width, height);
+    for (uint32_t i = 0; i < width * height; ++i)
+        map[i] = rand.next_double() < 0.55 ? 1.5f : 0.5f;
+
+    Segments labelled(width, height);
+    SegmentLabeller(wd).label(map, width, height, labelled);
+
+    Bounds bounds(wd, FloatPoint(0, 0), Dimension(width, height));
+    Segments filled(width, height);
+    PlateScratch scratch;
+    MySegmentCreator creator(bounds, &filled, map, wd, scratch);
+    createAll(creator, map, width, height);
+
+    ASSERT_EQ(filled.size(), labelled.size());
+    for (uint32_t i = 0; i < width * height; ++i)
+        ASSERT_EQ(filled.id(i), labelled.id(i));
+    for (uint32_t s = 0; s < filled.size(); ++s) {
+        EXPECT_EQ(filled[s].area(), labelled[s].area());
+        EXPECT_EQ(filled[s].getLeft(), labelled[s].getLeft());
+        EXPECT_EQ(filled[s].getRight(), labelled[s].getRight());
+        EXPECT_EQ(filled[s].getTop(), labelled[s].getTop());
+        EXPECT_EQ(filled[s].getBottom(), labelled[s].getBottom());
+    }
+}
+
+TEST(SegmentLabeller, SameAsFloodFill)
+{
+    expectSameAsFloodFill(1, 150, 70, WorldDimension(200, 100));
+    expectSameAsFloodFill(2, 64, 33, WorldDimension(64, 33));
+    expectSameAsFloodFill(3, 130, 40, WorldDimension(130, 90));
+}
+
+// After random changes to the map, update() must find the same continents
+// label() finds from scratch, though their IDs may differ.
+void expectUpdateSameAsLabel(uint32_t seed, uint32_t width, uint32_t height,
+                             const WorldDimension& wd)
+{
+    SimpleRandom rand(seed);
+    CrustMap map(width, height);
+    for (uint32_t i = 0; i < width * height; ++i)
+        map[i] = rand.next_double() < 0.5 ? 1.5f : 0.5f;
+
+    Segments kept(width, height);
+    SegmentLabeller updater(wd);
+    updater.update(map, width, height, kept);
+
+    for (uint32_t step = 0; step < 20; ++step)
+    {
+        for (uint32_t n = 0; n < 15; ++n) {
+            const uint32_t x = rand.next() % width, y = rand.next() % height;
+            map.set(x, y, map.get(x, y) >= CONT_BASE ? 0.5f : 1.5f);
+            updater.markDirty(x, y);
+        }
+        updater.update(map, width, height, kept);
+
+        Segments fresh(width, height);
+        SegmentLabeller(wd).label(map, width, height, fresh);
+
+        std::vector<ContinentId> match(kept.size(), UNLABELLED);
+        uint32_t existing = 0;
+        for (uint32_t s = 0; s < kept.size(); ++s)
+            existing += !kept[s].isEmpty();
+        ASSERT_EQ(fresh.size(), existing);
+
+        for (uint32_t i = 0; i < width * height; ++i)
+        {
+            if (fresh.id(i) == UNLABELLED) {
+                ASSERT_EQ(UNLABELLED, kept.id(i));
+                continue;
+            }
+            ASSERT_LT(kept.id(i), kept.size());
+            if (match[kept.id(i)] == UNLABELLED)
+                match[kept.id(i)] = fresh.id(i);
+            ASSERT_EQ(match[kept.id(i)], fresh.id(i));
+        }
+
+        for (uint32_t s = 0; s < kept.size(); ++s) {
+            if (kept[s].isEmpty())
+                continue;
+            const ISegmentData& f = fresh[match[s]];
+            EXPECT_EQ(f.area(), kept[s].area());
+            EXPECT_EQ(f.getLeft(), kept[s].getLeft());
+            EXPECT_EQ(f.getRight(), kept[s].getRight());
+            EXPECT_EQ(f.getTop(), kept[s].getTop());
+            EXPECT_EQ(f.getBottom(), kept[s].getBottom());
+        }
+    }
+}
+
+TEST(SegmentLabeller, UpdateSameAsLabel)
+{
+    expectUpdateSameAsLabel(4, 90, 60, WorldDimension(200, 100));
+    expectUpdateSameAsLabel(5, 48, 40, WorldDimension(48, 40));
+}
@@ -0,0 +1,119 @@
+/******************************************************************************
+ *  plate-tectonics, a plate tectonics simulation library
+ *  Copyright (C) 2012-2013 Lauri Viitanen
+ *  Copyright (C) 2014-2015 Federico Tomassetti, Bret Curtis
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, see http://www.gnu.org/licenses/
+ *****************************************************************************/
+
+#include "tile_occupancy.hpp"
+#include "heightmap.hpp"
+#include "gtest/gtest.h"
+
+TEST(TileOccupancy, Build)
+{
+    CrustMap map(200, 100);
+    map.set_all(0.0f);
+    map.set( 70, 10, 1.0f);
+    map.set(199, 99, 0.5f);
+
+    TileOccupancy tiles;
+    tiles.build(map);
+    EXPECT_EQ(2, tiles.occupiedTiles());
+    EXPECT_TRUE(tiles.occupied(64, 0));
+    EXPECT_TRUE(tiles.occupied(127, 63));
+    EXPECT_TRUE(tiles.occupied(192, 64));
+    EXPECT_FALSE(tiles.occupied(0, 0));
+    EXPECT_FALSE(tiles.occupied(70, 64));
+}
+
+TEST(TileOccupancy, Fill)
+{
+    TileOccupancy tiles;
+    tiles.fill(200, 100);
+    EXPECT_EQ(8, tiles.occupiedTiles());
+
+    uint32_t begin, finish;
+    ASSERT_TRUE(tiles.nextRun(99, 0, 200, begin, finish));
+    EXPECT_EQ(0, begin);
+    EXPECT_EQ(200, finish);
+}
+
+TEST(TileOccupancy, NextRun)
+{
+    CrustMap map(300, 10);
+    map.set_all(0.0f);
+    map.set( 10, 0, 1.0f);
+    map.set( 70, 0, 1.0f);
+    map.set(260, 0, 1.0f);
+
+    TileOccupancy tiles;
+    tiles.build(map);
+
+    uint32_t begin, finish;
+    ASSERT_TRUE(tiles.nextRun(5, 0, 300, begin, finish));
+    EXPECT_EQ(0, begin);
+    EXPECT_EQ(128, finish);
+    ASSERT_TRUE(tiles.nextRun(5, finish, 300, begin, finish));
+    EXPECT_EQ(256, begin);
+    EXPECT_EQ(300, finish);
+    EXPECT_FALSE(tiles.nextRun(5, finish, 300, begin, finish));
+
+    // Runs are clipped to the requested columns.
+    ASSERT_TRUE(tiles.nextRun(5, 100, 270, begin, finish));
+    EXPECT_EQ(100, begin);
+    EXPECT_EQ(128, finish);
+    EXPECT_FALSE(tiles.nextRun(5, 128, 256, begin, finish));
+}
+
+TEST(TileOccupancy, MarkAndGrow)
+{
+    CrustMap map(100, 100);
+    map.set_all(0.0f);
+
+    TileOccupancy tiles;
+    tiles.build(map);
+    EXPECT_EQ(0, tiles.occupiedTiles());
+
+    tiles.mark(60, 60);
+    EXPECT_EQ(1, tiles.occupiedTiles());
+
+    // The old tile straddles four new ones once moved by 8 points.
+    tiles.grow(200, 216, 8, 16);
+    EXPECT_EQ(200, tiles.width());
+    EXPECT_EQ(216, tiles.height());
+    EXPECT_EQ(4, tiles.occupiedTiles());
+    EXPECT_TRUE(tiles.occupied(8, 16));
+    EXPECT_TRUE(tiles.occupied(68, 76));
+    EXPECT_FALSE(tiles.occupied(130, 16));
+    EXPECT_FALSE(tiles.occupied(8, 130));
+}
+
+TEST(TileOccupancy, Refresh)
+{
+    CrustMap map(200, 200);
+    map.set_all(0.0f);
+    map.set(100, 100, 1.0f);
+
+    TileOccupancy tiles;
+    tiles.build(map);
+
+    // Crust moves over to the tile above and leaves its own tile empty.
+    map.set(100, 100, 0.0f);
+    map.set(100,  63, 1.0f);
+    tiles.refresh(map);
+    EXPECT_EQ(1, tiles.occupiedTiles());
+    EXPECT_TRUE(tiles.occupied(100, 63));
+    EXPECT_FALSE(tiles.occupied(100, 100));
+}
@@ -0,0 +1,128 @@
+/******************************************************************************
+ *  plate-tectonics, a plate tectonics simulation library
+ *  Copyright (C) 2012-2013 Lauri Viitanen
+ *  Copyright (C) 2014-2015 Federico Tomassetti, Bret Curtis
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, see http://www.gnu.org/licenses/
+ *****************************************************************************/
+
+#include "tiled_matrix.hpp"
+#include "gtest/gtest.h"
+
+TEST(TiledMatrix, GetAndSet)
+{
+    TiledMatrix<float> m(100, 70);
+    EXPECT_EQ(100U, m.width());
+    EXPECT_EQ(70U, m.height());
+    EXPECT_EQ(7000U, m.area());
+    EXPECT_EQ(0U, m.allocatedTiles());
+    EXPECT_EQ(0.0f, m.get(99, 69));
+
+    m.set(70, 10, 1.5f);
+    m[69 * 100 + 3] = 2.5f;
+    EXPECT_EQ(1.5f, m.get(70, 10));
+    EXPECT_EQ(1.5f, m[10 * 100 + 70]);
+    EXPECT_EQ(2.5f, m.get(3, 69));
+    EXPECT_EQ(0.0f, m.get(71, 10));
+    EXPECT_EQ(2U, m.allocatedTiles());
+    EXPECT_TRUE(m.hasTile(1, 0));
+    EXPECT_TRUE(m.hasTile(0, 1));
+    EXPECT_FALSE(m.hasTile(0, 0));
+
+    // Reads never allocate.
+    const TiledMatrix<float>& c = m;
+    EXPECT_EQ(0.0f, c[0]);
+    EXPECT_EQ(2U, m.allocatedTiles());
+}
+
+TEST(TiledMatrix, FillValue)
+{
+    TiledMatrix<int> m(10, 10, -1);
+    EXPECT_EQ(-1, m.get(5, 5));
+    m.set(5, 5, 3);
+    EXPECT_EQ(1U, m.allocatedTiles());
+    m.set_all(-1);
+    EXPECT_EQ(0U, m.allocatedTiles());
+    EXPECT_EQ(-1, m.get(5, 5));
+    m.set_all(4);
+    EXPECT_EQ(4, m.get(9, 9));
+}
+
+TEST(TiledMatrix, SparseContentTakesFewTiles)
+{
+    TiledMatrix<float> m(4096, 4096);
+    for (uint32_t x = 1000; x < 1100; ++x)
+        m.set(x, 2000, 1.0f);
+    EXPECT_EQ(3U, m.allocatedTiles());
+}
+
+TEST(TiledMatrix, Grow)
+{
+    TiledMatrix<float> m(3, 2);
+    m.set(0, 0, 1.0f);
+    m.set(2, 1, 2.0f);
+    m.grow(200, 100, 150, 90, 0.0f);
+    EXPECT_EQ(200U, m.width());
+    EXPECT_EQ(100U, m.height());
+    EXPECT_EQ(1.0f, m.get(150, 90));
+    EXPECT_EQ(2.0f, m.get(152, 91));
+    EXPECT_EQ(0.0f, m.get(0, 0));
+    EXPECT_EQ(1U, m.allocatedTiles());
+}
+
+TEST(TiledMatrix, Crop)
+{
+    TiledMatrix<float> m(200, 100);
+    m.set(10, 10, 1.0f);
+    m.set(150, 90, 2.0f);
+    m.crop(100, 50, 100, 50);
+    EXPECT_EQ(100U, m.width());
+    EXPECT_EQ(50U, m.height());
+    EXPECT_EQ(2.0f, m.get(50, 40));
+    EXPECT_EQ(1U, m.allocatedTiles());
+}
+
+TEST(TiledMatrix, AssignAndCopyTo)
+{
+    float values[70 * 3];
+    for (uint32_t i = 0; i < 70 * 3; ++i)
+        values[i] = 0.0f;
+    values[1 * 70 + 68] = 3.0f;
+
+    TiledMatrix<float> m(70, 3);
+    m.set(1, 1, 5.0f);
+    m.assign(values);
+    EXPECT_EQ(0.0f, m.get(1, 1));
+    EXPECT_EQ(3.0f, m.get(68, 1));
+    EXPECT_EQ(1U, m.allocatedTiles());
+    EXPECT_FALSE(m.hasTile(0, 0));
+
+    float out[70 * 3];
+    m.copyTo(out);
+    for (uint32_t i = 0; i < 70 * 3; ++i)
+        EXPECT_EQ(values[i], out[i]);
+}
+
+TEST(TiledMatrix, Run)
+{
+    TiledMatrix<float> m(100, 2);
+    m.set(80, 1, 1.0f);
+    uint32_t end;
+    EXPECT_TRUE(m.run(10, 1, end) == NULL);
+    EXPECT_EQ(64U, end);
+    const float* run = m.run(70, 1, end);
+    ASSERT_TRUE(run != NULL);
+    EXPECT_EQ(100U, end);
+    EXPECT_EQ(1.0f, run[10]);
+}
@@ -0,0 +1,58 @@
+/******************************************************************************
+ *  plate-tectonics, a plate tectonics simulation library
+ *  Copyright (C) 2012-2013 Lauri Viitanen
+ *  Copyright (C) 2014-2015 Federico Tomassetti, Bret Curtis
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, see http://www.gnu.org/licenses/
+ *****************************************************************************/
+
+#include "world_storage.hpp"
+#include "lithosphere.hpp"
+#include "gtest/gtest.h"
+
+TEST(WorldStorage, WideMapIsHandedOutAsIs)
+{
+    Matrix<uint32_t> map(10, 5);
+    Matrix<uint32_t> view(1, 1);
+    EXPECT_EQ(map.raw_data(), widenedMap(map, view));
+}
+
+TEST(WorldStorage, NarrowMapIsWidened)
+{
+    Matrix<uint8_t> map(10, 5);
+    for (uint32_t i = 0; i < map.area(); ++i)
+        map[i] = (uint8_t)(i * 7);
+    map[3] = (uint8_t)-1;
+
+    Matrix<uint32_t> view(1, 1);
+    const uint32_t* wide = widenedMap(map, view);
+    ASSERT_EQ(10u, view.width());
+    ASSERT_EQ(5u, view.height());
+    EXPECT_EQ(view.raw_data(), wide);
+    for (uint32_t i = 0; i < map.area(); ++i) {
+        if (i == 3)
+            EXPECT_EQ(0xFFFFFFFFu, wide[i]);
+        else
+            EXPECT_EQ(map[i], wide[i]);
+    }
+}
+
+TEST(WorldStorage, PlatesMustFitTheIndexMap)
+{
+    const uint32_t too_many = NO_PLATE;
+    if (too_many > 1000)
+        return; // Only an 8 bit index map is cheap to overflow.
+    EXPECT_THROW(lithosphere(3, 64, 64, 0.65, 60, 0.02, 1000000, 0.33, 2,
+                             too_many), invalid_argument);
+}
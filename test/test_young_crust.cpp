@@ -0,0 +1,91 @@
+/******************************************************************************
+ *  plate-tectonics, a plate tectonics simulation library
+ *  Copyright (C) 2012-2013 Lauri Viitanen
+ *  Copyright (C) 2014-2015 Federico Tomassetti, Bret Curtis
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, see http://www.gnu.org/licenses/
+ *****************************************************************************/
+
+#include "young_crust.hpp"
+#include "gtest/gtest.h"
+
+TEST(YoungCrust, ListsPointsByAge)
+{
+    YoungCrust young;
+    young.add(3, 10);
+    young.add(5, 12);
+    young.add(7, 10);
+    young.add(9, 0);
+
+    ASSERT_EQ(2, young.points(10).size());
+    EXPECT_EQ(3, young.points(10)[0]);
+    EXPECT_EQ(7, young.points(10)[1]);
+    ASSERT_EQ(1, young.points(12).size());
+    EXPECT_EQ(0, young.points(11).size());
+    EXPECT_EQ(0, young.points(100).size());
+    EXPECT_EQ(0, young.points(0).size());
+    EXPECT_EQ(3, young.size());
+}
+
+TEST(YoungCrust, ForgetsOlderAges)
+{
+    YoungCrust young;
+    young.add(1, 10);
+    young.add(2, 11);
+    young.forget(11);
+
+    EXPECT_EQ(0, young.points(10).size());
+    EXPECT_EQ(1, young.points(11).size());
+
+    // Forgotten ages are not listed anymore.
+    young.add(3, 10);
+    EXPECT_EQ(0, young.points(10).size());
+    EXPECT_EQ(1, young.size());
+}
+
+TEST(YoungCrust, Build)
+{
+    const CrustAge values[6] = { 0, 4, 9, 5, 30, 4 };
+    CrustAgeMap ages(3, 2);
+    for (uint32_t i = 0; i < 6; ++i)
+        ages.set(i % 3, i / 3, values[i]);
+    YoungCrust young;
+    young.add(0, 7);
+    young.build(ages, 5);
+
+    EXPECT_EQ(0, young.points(7).size());
+    EXPECT_EQ(0, young.points(4).size());
+    ASSERT_EQ(1, young.points(30).size());
+    EXPECT_EQ(4, young.points(30)[0]);
+    EXPECT_EQ(3, young.size());
+}
+
+TEST(YoungCrust, GrowAndCrop)
+{
+    // Points (1, 1) and (3, 2) of a 4 points wide map.
+    YoungCrust young;
+    young.add(1 * 4 + 1, 10);
+    young.add(2 * 4 + 3, 11);
+
+    // 6 points wide, moved by (2, 1).
+    young.grow(4, 6, 2, 1);
+    EXPECT_EQ(2 * 6 + 3, young.points(10)[0]);
+    EXPECT_EQ(3 * 6 + 5, young.points(11)[0]);
+
+    // Only (5, 3) is inside a 2x2 rectangle at (4, 2).
+    young.crop(6, 4, 2, 2, 2);
+    EXPECT_EQ(0, young.points(10).size());
+    ASSERT_EQ(1, young.points(11).size());
+    EXPECT_EQ(1 * 2 + 1, young.points(11)[0]);
+}